@@ -1,63 +1,111 @@
 #pragma once
 
+#include <stdint.h>
+#include <stdio.h>
 #include <string.h>
 
+#include <algorithm>
+#include <limits>
+#include <type_traits>
+#include <stdexcept>
+#include <vector>
+
+#include "risp_inputs.hpp"
+#include "risp_noise.hpp"
+#include "risp_snapshot.hpp"
+#include "risp_topology.hpp"
+#include "risp_tracking.hpp"
+
 using namespace std;
 
+// The RISP simulation engine.  A specific network is a subclass of
+// Engine<Network, MAX_DELAY> that holds its neurons and synapses in tables;
+// it is generated from the network JSON by bin/network_to_header (see the
+// makefile), so that the hot path never has to look anything up.
+
 namespace risp
 {
-    typedef struct {
+    class Network;
 
-        int weight;     
-        class Neuron *to;       
-        uint32_t delay;  
+    template <class Net, uint32_t MAX_DELAY, class P, class T> class Engine;
 
-    } synapse_t;
+    typedef enum { LEAK_NONE, LEAK_ALL, LEAK_CONFIGURABLE } leak_mode_t;
 
-    class Constants {
+    // The parameters that change what a timestep does, fixed at compile time
+    // so that the engine's kernel is specialized for them rather than
+    // testing them per event.  The generator picks one from the params.
 
-        friend class Neuron;
-        friend class Network;
+    template <leak_mode_t LEAK_MODE, bool THRESHOLD_INCLUSIVE, bool RUN_TIME_INCLUSIVE,
+             bool INPUTS_FROM_WEIGHTS, bool NOISY = false>
+    class Policy {
 
-        private:
+        public:
 
-        static const size_t MAX_SYNAPASES_PER_NEURON = 50;
-        static const size_t MAX_EVENT_VECTORS = 300;
-        static const size_t MAX_EVENTS_PER_VECTOR = 300;
+            static const leak_mode_t leak_mode = LEAK_MODE;
+            static const bool threshold_inclusive = THRESHOLD_INCLUSIVE;
+            static const bool run_time_inclusive = RUN_TIME_INCLUSIVE;
+            static const bool inputs_from_weights = INPUTS_FROM_WEIGHTS;
+            static const bool noisy = NOISY;
     };
 
-    class Neuron {
-        
+    typedef Policy<LEAK_NONE, true, false, false> Default_Policy;
+
+    // The storage types of a neuron's charge and threshold, of a synapse's
+    // weight and delay, and of a neuron index.  The generator picks the narrowest ones
+    // that hold the params' ranges (see network_to_header), and integer
+    // charges saturate at their type's limits rather than wrap.  RISP-F
+    // networks (discrete false) use float charges and weights.
+
+    template <class CHARGE, class WEIGHT, class DELAY, class INDEX = uint32_t>
+    class Types {
+
+        public:
+
+            typedef CHARGE charge_t;
+            typedef WEIGHT weight_t;
+            typedef DELAY delay_t;
+            typedef INDEX index_t;
+    };
+
+    typedef Types<int, int, uint32_t> Default_Types;
+
+    template <class T> class Basic_Neuron {
+
         friend class Network;
+        template <class Net, uint32_t MAX_DELAY, class P, class T2> friend class Engine;
 
         private:
 
-            synapse_t synapses[Constants::MAX_SYNAPASES_PER_NEURON]; 
-            
-            size_t synapse_count;
-            int id;
-            int charge;             
-            int threshold;         
-            int last_check;          
-            int last_fire;          
-            uint32_t fire_counts;  
-            bool leak;            
-            bool check;         
-            class Synapse * synapse_list_head;
-            class Synapse * synapse_list_tail;
-
-            Neuron(int t) 
-                : synapse_count(0),
-                id(-1),
-                charge(0),
+            typedef typename T::charge_t charge_t;
+
+            charge_t charge;
+            charge_t threshold;
+            bool leak;
+            bool check;
+            bool log;                   // A tracked output (see Output_Log)
+            bool trace;                 // A tracked neuron (see Spike_Log)
+            uint32_t first_edge;
+            uint32_t end_edge;
+            int last_fire;
+            uint32_t fire_counts;
+            uint64_t activity_epoch;
+            uint64_t tracking_epoch;
+
+            // The neuron's synapses are the engine's edges[first .. end).
+
+            Basic_Neuron(charge_t t, bool l, uint32_t first, uint32_t end)
+                : charge(0),
                 threshold(t),
-                last_check(-1),
+                leak(l),
+                check(false),
+                log(false),
+                trace(false),
+                first_edge(first),
+                end_edge(end),
                 last_fire(-1),
                 fire_counts(0),
-                leak(false),
-                check(false),
-                synapse_list_head(nullptr),
-                synapse_list_tail(nullptr) {};
+                activity_epoch(0),
+                tracking_epoch(0) {};
 
             void perform_fire(int time)
             {
@@ -66,782 +114,900 @@ namespace risp
                 charge = 0;
             }
 
-            void reset(const int min_potential)
+            // State stamped with an older epoch than the engine's was cleared
+            // since it was written, and is cleared here on first use.  Every
+            // clear_activity() also advances the tracking epoch, so one test
+            // covers the common case of a neuron that is up to date.
+
+            void refresh(const uint64_t activity, const uint64_t tracking)
             {
-                if (leak) {
+                if (__builtin_expect(tracking_epoch == tracking, 1)) return;
+
+                if (activity_epoch != activity) {
                     charge = 0;
+                    activity_epoch = activity;
                 }
 
-                if (charge < min_potential) {
-                    charge = min_potential;
-                }
+                last_fire = -1;
+                fire_counts = 0;
+                tracking_epoch = tracking;
             }
 
-            void clear_tracking_info()
+   };
+
+    // Net must provide reset_neurons(), which the generator unrolls over its
+    // neurons as calls to reset_neuron().  MAX_DELAY is the largest synapse
+    // delay in the network, P is a Policy and T is a Types.
+    //
+    // Net's constructor points neurons at its neuron table, edges at one
+    // packed edge table sorted by source neuron, and output_neurons at the
+    // output neurons' indices.  Each neuron records the range of its synapses
+    // in edges.  It then calls allocate_events().
+    //
+    // Clearing is O(1): clear_activity() and the tracking reset at the start
+    // of each run() just advance an epoch.  Neurons and buckets carry the
+    // epoch they were last written in, and stale ones are cleared when next
+    // touched.  reset_neurons() touches every neuron at the end of a run.
+    //
+    // Events are scheduled on a ring of EVENT_RING_SIZE buckets indexed by
+    // absolute timestep modulo the ring size.  Every synapse delay is less
+    // than the ring size, so a bucket is always drained before it is reused,
+    // and runs may be arbitrarily long and back to back.  The buckets are
+    // equal slices of one arena, sized from the network by allocate_events()
+    // so that synapses alone can never overflow one.  Only applied spikes
+    // beyond one per input per timestep can grow the arena.
+
+    template <class Net, uint32_t MAX_DELAY, class P = Default_Policy,
+             class T = Default_Types> class Engine {
+
+        public:
+
+            void run(int timesteps)
             {
-                last_fire = -1;
-                fire_counts = 0;
+                if (overall_run_time != 0) {
+                    tracking_epoch++;
+                }
+
+                spike_log.clear();
+
+                if (timesteps <= 0 && !P::run_time_inclusive) return;
+
+                const size_t run_time = (P::run_time_inclusive) ? timesteps : timesteps-1;
+
+                run_start = overall_run_time;
+
+                overall_run_time += (run_time+1);
+
+                // Only timesteps with events (or inputs due) are processed.
+
+                for (uint32_t t = next_event_time(run_start); t < overall_run_time;
+                        t = next_event_time(t + 1)) {
+                    process_events(t);
+                }
+
+                net()->reset_neurons();
+
             }
 
             void clear_activity()
             {
-                last_fire = -1;
-                fire_counts = 0;
-                charge = 0;
-                last_check = -1;
+                activity_epoch++;
+                tracking_epoch++;
+
+                far_inputs.clear();
+                spike_log.clear();
+
+                overall_run_time = 0;
             }
-   };
 
-    class Synapse {
+            uint32_t get_time() const
+            {
+                return overall_run_time;
+            }
 
-        friend class Neuron;
-        friend class Network;
+            size_t num_outputs() const
+            {
+                return output_neuron_count;
+            }
 
-        private:
+            // Output o's node id.
+
+            int output_id(const size_t o) const
+            {
+                return neuron_ids[output_neurons[o]];
+            }
 
-            Neuron * from;       
-            Neuron * to;       
-            int weight;     
-            uint32_t delay;  
-            class Synapse * next;
+            // Output state since the start of the last run(), as in
+            // markdown/processor.md.  A last fire is a timestep of that run,
+            // or -1 if the output hasn't fired.  The pointer forms fill an
+            // array of num_outputs(), for loops that read outputs every run.
 
-            Synapse(Neuron * f, Neuron * t, int w, uint32_t d) 
-                : from(f), to(t), weight(w), delay(d), next(nullptr) { }
-    };
+            uint32_t output_count(const size_t o) const
+            {
+                return fire_count(neurons[output_neurons[o]]);
+            }
 
+            int output_last_fire(const size_t o) const
+            {
+                const Neuron & n = neurons[output_neurons[o]];
 
-    class Network {
+                return (n.tracking_epoch == tracking_epoch) ? n.last_fire : -1;
+            }
 
-        public:
+            void output_counts(uint32_t * counts) const
+            {
+                for (size_t o = 0; o < output_neuron_count; o++) counts[o] = output_count(o);
+            }
 
-            Network() 
+            void output_last_fires(int * times) const
             {
-                neuron_count = 0;
+                for (size_t o = 0; o < output_neuron_count; o++) times[o] = output_last_fire(o);
+            }
 
-                spike_value_factor = 7;
-                min_potential = -7;
-                run_time_inclusive = false;
-                threshold_inclusive = true;
-                discrete = true;
-                inputs_from_weights = false;
-                overall_run_time = 0;
+            std::vector<uint32_t> output_counts() const
+            {
+                std::vector<uint32_t> v(output_neuron_count);
+
+                output_counts(v.data());
 
-                add_synapse(&n11, &n102, -7, 9);
-                add_synapse(&n8, &n34, 5, 3);
-                add_synapse(&n12, &n17, 3, 10);
-                add_synapse(&n1, &n11, -6, 12);
-                add_synapse(&n8, &n2, -2, 1);
-                add_synapse(&n13, &n1, 4, 2);
-                add_synapse(&n8, &n9, -2, 14);
-                add_synapse(&n2, &n8, 3, 7);
-                add_synapse(&n13, &n26, -6, 4);
-                add_synapse(&n64, &n95, -1, 6);
-                add_synapse(&n20, &n15, 3, 7);
-                add_synapse(&n16, &n13, 3, 8);
-                add_synapse(&n80, &n34, 0, 9);
-                add_synapse(&n60, &n26, 2, 11);
-                add_synapse(&n8, &n15, -3, 6);
-                add_synapse(&n6, &n9, 2, 3);
-                add_synapse(&n77, &n101, 2, 14);
-                add_synapse(&n26, &n11, 2, 1);
-                add_synapse(&n9, &n20, 6, 9);
-                add_synapse(&n0, &n22, -5, 15);
-                add_synapse(&n51, &n1, -7, 1);
-                add_synapse(&n2, &n77, 6, 7);
-                add_synapse(&n1, &n3, 1, 3);
-                add_synapse(&n2, &n42, 1, 2);
-                add_synapse(&n3, &n16, -7, 13);
-                add_synapse(&n32, &n60, -2, 14);
-                add_synapse(&n10, &n1, -2, 3);
-                add_synapse(&n6, &n10, 0, 3);
-                add_synapse(&n16, &n62, 0, 1);
-                add_synapse(&n102, &n30, -3, 11);
-                add_synapse(&n60, &n10, 6, 9);
-                add_synapse(&n32, &n34, 1, 1);
-                add_synapse(&n32, &n2, -4, 14);
-                add_synapse(&n30, &n32, 0, 9);
-                add_synapse(&n13, &n3, 5, 3);
-                add_synapse(&n26, &n77, 1, 15);
-                add_synapse(&n64, &n13, -2, 12);
-                add_synapse(&n2, &n67, 2, 14);
-                add_synapse(&n11, &n8, -7, 8);
-                add_synapse(&n5, &n95, 4, 9);
-                add_synapse(&n30, &n80, 5, 5);
-                add_synapse(&n9, &n51, -5, 12);
-                add_synapse(&n51, &n8, 1, 15);
-                add_synapse(&n0, &n1, -4, 3);
-                add_synapse(&n11, &n6, 3, 14);
-                add_synapse(&n101, &n26, 2, 2);
-                add_synapse(&n4, &n93, 1, 4);
-                add_synapse(&n1, &n17, -3, 14);
-                add_synapse(&n9, &n4, -1, 7);
-                add_synapse(&n95, &n60, 6, 8);
-                add_synapse(&n1, &n30, 1, 13);
-                add_synapse(&n17, &n102, 4, 1);
-                add_synapse(&n6, &n26, 6, 2);
-                add_synapse(&n0, &n26, 7, 1);
-                add_synapse(&n4, &n0, 2, 15);
-                add_synapse(&n2, &n3, 2, 9);
-                add_synapse(&n101, &n10, 1, 4);
-                add_synapse(&n51, &n11, 0, 14);
-                add_synapse(&n8, &n51, 7, 5);
-                add_synapse(&n10, &n68, 1, 4);
-                add_synapse(&n4, &n33, 1, 6);
-                add_synapse(&n8, &n0, 0, 4);
-                add_synapse(&n0, &n13, 3, 8);
-                add_synapse(&n68, &n12, -2, 13);
-                add_synapse(&n12, &n80, -4, 3);
-                add_synapse(&n4, &n4, 5, 3);
-                add_synapse(&n5, &n93, 7, 12);
-                add_synapse(&n9, &n77, -2, 15);
-                add_synapse(&n1, &n2, -1, 6);
-                add_synapse(&n6, &n8, 3, 12);
-                add_synapse(&n11, &n7, -2, 5);
-                add_synapse(&n80, &n32, 1, 11);
-                add_synapse(&n9, &n26, 5, 4);
-                add_synapse(&n15, &n10, 1, 10);
-                add_synapse(&n33, &n30, 4, 9);
-                add_synapse(&n6, &n88, -6, 15);
-                add_synapse(&n93, &n12, 1, 1);
-                add_synapse(&n88, &n10, 2, 14);
-                add_synapse(&n18, &n41, -3, 8);
-                add_synapse(&n0, &n18, 4, 14);
-                add_synapse(&n11, &n41, 2, 12);
-                add_synapse(&n6, &n51, -1, 10);
-                add_synapse(&n30, &n101, -5, 14);
-                add_synapse(&n13, &n4, 3, 15);
-                add_synapse(&n60, &n17, -4, 8);
-                add_synapse(&n80, &n10, 3, 6);
-                add_synapse(&n102, &n1, 7, 8);
-                add_synapse(&n12, &n8, 0, 12);
-                add_synapse(&n5, &n13, 2, 1);
-                add_synapse(&n20, &n95, 2, 8);
-                add_synapse(&n42, &n5, 4, 6);
-                add_synapse(&n7, &n32, 1, 11);
-                add_synapse(&n33, &n51, -5, 15);
-                add_synapse(&n67, &n102, 3, 10);
-                add_synapse(&n41, &n77, 6, 6);
-                add_synapse(&n60, &n93, -6, 12);
-                add_synapse(&n77, &n95, 3, 8);
-                add_synapse(&n80, &n26, -3, 6);
-                add_synapse(&n17, &n0, 2, 10);
-                add_synapse(&n60, &n0, -5, 9);
-                add_synapse(&n62, &n4, 7, 5);
-                add_synapse(&n68, &n11, 6, 7);
-                add_synapse(&n9, &n2, 0, 4);
-                add_synapse(&n0, &n95, -2, 14);
-                add_synapse(&n34, &n7, 1, 10);
-                add_synapse(&n64, &n3, 4, 14);
-                add_synapse(&n9, &n67, -5, 3);
-                add_synapse(&n22, &n64, -1, 13);
-                add_synapse(&n10, &n41, -7, 15);
-                add_synapse(&n67, &n9, 5, 13);
-                add_synapse(&n51, &n34, -4, 14);
-                add_synapse(&n2, &n6, 3, 14);
-                add_synapse(&n51, &n60, 0, 12);
-
-                connect_synapse(&s11_102);
-                connect_synapse(&s11_8);
-                connect_synapse(&s12_17);
-                connect_synapse(&s1_11);
-                connect_synapse(&s8_2);
-                connect_synapse(&s13_1);
-                connect_synapse(&s8_9);
-                connect_synapse(&s2_8);
-                connect_synapse(&s13_26);
-                connect_synapse(&s64_);
-                connect_synapse(&s20_15);
-                connect_synapse(&s16_13);
-                connect_synapse(&s80_34);
-                connect_synapse(&s60_26);
-                connect_synapse(&s8_15);
-                connect_synapse(&s6_9);
-                connect_synapse(&s77_101);
-                connect_synapse(&s26_11);
-                connect_synapse(&s9_20);
-                connect_synapse(&s0_22);
-                connect_synapse(&s51_1);
-                connect_synapse(&s2_77);
-                connect_synapse(&s1_3);
-                connect_synapse(&s2_42);
-                connect_synapse(&s3_16);
-                connect_synapse(&s32_60);
-                connect_synapse(&s10_1);
-                connect_synapse(&s6_10);
-                connect_synapse(&s16_62);
-                connect_synapse(&s102_30);
-                connect_synapse(&s60_10);
-                connect_synapse(&s32_34);
-                connect_synapse(&s32_2);
-                connect_synapse(&s30_32);
-                connect_synapse(&s13_3);
-                connect_synapse(&s26_77);
-                connect_synapse(&s64_13);
-                connect_synapse(&s2_67);
-                connect_synapse(&s11_8);
-                connect_synapse(&s5_95);
-                connect_synapse(&s30_80);
-                connect_synapse(&s9_51);
-                connect_synapse(&s51_8);
-                connect_synapse(&s0_1);
-                connect_synapse(&s11_6);
-                connect_synapse(&s101_26);
-                connect_synapse(&s4_93);
-                connect_synapse(&s1_17);
-                connect_synapse(&s9_4);
-                connect_synapse(&s95_60);
-                connect_synapse(&s1_30);
-                connect_synapse(&s17_102);
-                connect_synapse(&s6_26);
-                connect_synapse(&s0_26);
-                connect_synapse(&s4_0);
-                connect_synapse(&s2_3);
-                connect_synapse(&s101_10);
-                connect_synapse(&s51_11);
-                connect_synapse(&s8_51);
-                connect_synapse(&s10_68);
-                connect_synapse(&s4_33);
-                connect_synapse(&s8_0);
-                connect_synapse(&s0_13);
-                connect_synapse(&s68_12);
-                connect_synapse(&s12_80);
-                connect_synapse(&s4_4);
-                connect_synapse(&s5_93);
-                connect_synapse(&s9_77);
-                connect_synapse(&s1_2);
-                connect_synapse(&s6_8);
-                connect_synapse(&s11_7);
-                connect_synapse(&s80_32);
-                connect_synapse(&s9_26);
-                connect_synapse(&s15_10);
-                connect_synapse(&s33_30);
-                connect_synapse(&s6_88);
-                connect_synapse(&s93_12);
-                connect_synapse(&s88_10);
-                connect_synapse(&s18_41);
-                connect_synapse(&s0_18);
-                connect_synapse(&s11_41);
-                connect_synapse(&s6_51);
-                connect_synapse(&s30_101);
-                connect_synapse(&s13_4);
-                connect_synapse(&s60_17);
-                connect_synapse(&s80_10);
-                connect_synapse(&s102_1);
-                connect_synapse(&s12_8);
-                connect_synapse(&s5_13);
-                connect_synapse(&s20_95);
-                connect_synapse(&s42_5);
-                connect_synapse(&s7_32);
-                connect_synapse(&s33_51);
-                connect_synapse(&s67_102);
-                connect_synapse(&s41_77);
-                connect_synapse(&s60_93);
-                connect_synapse(&s77_95);
-                connect_synapse(&s80_26);
-                connect_synapse(&s17_0);
-                connect_synapse(&s60_0);
-                connect_synapse(&s62_4);
-                connect_synapse(&s68_11);
-                connect_synapse(&s9_2);
-                connect_synapse(&s0_95);
-                connect_synapse(&s34_7);
-                connect_synapse(&s64_3);
-                connect_synapse(&s9_67);
-                connect_synapse(&s22_64);
-                connect_synapse(&s10_41);
-                connect_synapse(&s67_9);
-                connect_synapse(&s51_34);
-                connect_synapse(&s2_6);
-                connect_synapse(&s51_60);
-
-                //debug_neuron(&n0);
-                //exit(0);
-
-            }
-
-            ~Network() {}
-
-            void apply_spike_input0(const int time)
-            {
-                apply_spike_input(&n0, time);
-            }
-
-            void apply_spike_input1(const int time)
-            {
-                apply_spike_input(&n1, time);
-            }
-
-            void apply_spike_input2(const int time)
-            {
-                apply_spike_input(&n2, time);
+                return v;
             }
 
-            void run(int timesteps)
+            std::vector<int> output_last_fires() const
             {
-                if (overall_run_time != 0) {
-                    clear_tracking_info();
+                std::vector<int> v(output_neuron_count);
+
+                output_last_fires(v.data());
+
+                return v;
+            }
+
+            // Turns recording of output o's fire times on or off.  The logs
+            // are allocated the first time, so call this before run().
+
+            bool track_output_events(const size_t o, const bool track = true)
+            {
+                if (o >= output_neuron_count) throw std::runtime_error("bad output index");
+
+                if (output_log.empty()) {
+                    output_log.resize(neuron_count, std::vector<uint32_t>(output_neurons,
+                                output_neurons + output_neuron_count));
                 }
 
-                const size_t run_time = (run_time_inclusive) ? timesteps : timesteps-1;
+                neurons[output_neurons[o]].log = track;
 
-                overall_run_time += (run_time+1);
+                return true;
+            }
 
-                for (size_t i = 0; i <= run_time; i++) {
-                    process_events(i);
-                }
-
-                reset_neurons();
-
-            }
-
-            void reset_neurons()
-            {
-                n0.reset(min_potential);
-                n1.reset(min_potential);
-                n2.reset(min_potential);
-                n3.reset(min_potential);
-                n4.reset(min_potential);
-                n5.reset(min_potential);
-                n6.reset(min_potential);
-                n7.reset(min_potential);
-                n8.reset(min_potential);
-                n9.reset(min_potential);
-                n10.reset(min_potential);
-                n11.reset(min_potential);
-                n12.reset(min_potential);
-                n13.reset(min_potential);
-                n15.reset(min_potential);
-                n16.reset(min_potential);
-                n17.reset(min_potential);
-                n18.reset(min_potential);
-                n20.reset(min_potential);
-                n22.reset(min_potential);
-                n26.reset(min_potential);
-                n30.reset(min_potential);
-                n32.reset(min_potential);
-                n33.reset(min_potential);
-                n34.reset(min_potential);
-                n41.reset(min_potential);
-                n42.reset(min_potential);
-                n51.reset(min_potential);
-                n60.reset(min_potential);
-                n62.reset(min_potential);
-                n64.reset(min_potential);
-                n67.reset(min_potential);
-                n68.reset(min_potential);
-                n77.reset(min_potential);
-                n80.reset(min_potential);
-                n88.reset(min_potential);
-                n93.reset(min_potential);
-                n95.reset(min_potential);
-                n101.reset(min_potential);
-                n102.reset(min_potential);
-            }
-
-            void report_counts()
-            {
-                printf("n3: %d\n", n3.fire_counts);
-            }
-
-            void clear_activity() 
-            {
-                clear_neuron_activities();
+            // Output o's fire times in the last run(), if it is tracked (at
+            // most Output_Log::LOG_SIZE, the last ones).
 
-                memset(events, 0, sizeof(events));
+            std::vector<int> output_vector(const size_t o) const
+            {
+                if (!neurons[output_neurons[o]].log) return std::vector<int>();
 
-                overall_run_time = 0;
+                return output_log.fire_times(output_neurons[o], tracking_epoch);
             }
 
-            void clear_neuron_activities()
-            {
-                n0.clear_activity();
-                n1.clear_activity();
-                n2.clear_activity();
-                n3.clear_activity();
-                n4.clear_activity();
-                n5.clear_activity();
-                n6.clear_activity();
-                n7.clear_activity();
-                n8.clear_activity();
-                n9.clear_activity();
-                n10.clear_activity();
-                n11.clear_activity();
-                n12.clear_activity();
-                n13.clear_activity();
-                n15.clear_activity();
-                n16.clear_activity();
-                n17.clear_activity();
-                n18.clear_activity();
-                n20.clear_activity();
-                n22.clear_activity();
-                n26.clear_activity();
-                n30.clear_activity();
-                n32.clear_activity();
-                n33.clear_activity();
-                n34.clear_activity();
-                n41.clear_activity();
-                n42.clear_activity();
-                n51.clear_activity();
-                n60.clear_activity();
-                n62.clear_activity();
-                n64.clear_activity();
-                n67.clear_activity();
-                n68.clear_activity();
-                n77.clear_activity();
-                n80.clear_activity();
-                n88.clear_activity();
-                n93.clear_activity();
-                n95.clear_activity();
-                n101.clear_activity();
-                n102.clear_activity();
+            std::vector< std::vector<int> > output_vectors() const
+            {
+                std::vector< std::vector<int> > v;
+
+                for (size_t o = 0; o < output_neuron_count; o++) v.push_back(output_vector(o));
+
+                return v;
             }
 
-        private:
+            // The node ids, sorted, which index neuron_vectors().
+
+            std::vector<int> node_ids() const
+            {
+                std::vector<int> v;
+
+                for (size_t i = 0; i < neuron_count; i++) v.push_back(neuron_ids[i]);
+
+                std::sort(v.begin(), v.end());
+
+                return v;
+            }
+
+            // Turns recording of a neuron's fires into the spike log on or
+            // off, by node id.  The log is allocated the first time, so call
+            // this before run().
+
+            bool track_neuron_events(const int id, const bool track = true)
+            {
+                if (spike_log.get_capacity() == 0) spike_log.resize(Spike_Log::DEFAULT_CAPACITY);
+
+                neurons[neuron_index(id)].trace = track;
+
+                return true;
+            }
+
+            // The most tracked fires the spike log holds in a run; later ones
+            // are dropped (see spikes_dropped()).  This discards the log.
+
+            void set_spike_log_capacity(const size_t entries)
+            {
+                spike_log.resize(entries);
+            }
+
+            // Each neuron's fire times in the last run(), if it is tracked, by
+            // node id in sorted order, as in markdown/processor.md.
+
+            std::vector< std::vector<int> > neuron_vectors() const
+            {
+                const std::vector<int> ids = node_ids();
+                std::vector< std::vector<int> > v(ids.size());
+
+                for (size_t i = 0; i < spike_log.entries(); i++) {
+                    const int id = neuron_ids[spike_log.neuron_at(i)];
+                    v[std::lower_bound(ids.begin(), ids.end(), id) - ids.begin()].push_back(
+                            spike_log.time_at(i));
+                }
+
+                return v;
+            }
+
+            // Copies up to max of the last run's tracked fires that haven't
+            // been drained yet, as node ids and timesteps in the order they
+            // fired, and returns how many.
+
+            size_t drain_spikes(int * ids, int * times, const size_t max)
+            {
+                const size_t n = spike_log.drain((uint32_t *) ids, times, max);
+
+                for (size_t i = 0; i < n; i++) ids[i] = neuron_ids[(uint32_t) ids[i]];
+
+                return n;
+            }
+
+            size_t spikes_dropped() const
+            {
+                return spike_log.dropped_count();
+            }
+
+            void report_counts() const
+            {
+                for (size_t o = 0; o < output_neuron_count; o++) {
+                    printf("n%d: %d\n", output_id(o), output_count(o));
+                }
+            }
+
+            // The most events any one bucket has held, and the number each
+            // can now hold without growing the arena.
+
+            size_t peak_bucket_events() const
+            {
+                return peak_events;
+            }
+
+            size_t bucket_capacity() const
+            {
+                return bucket_size;
+            }
+
+            // The checksum of the edge table, by node id.
+
+            Topology_Checksum topology_checksum() const
+            {
+                Topology_Checksum c;
+
+                for (size_t i = 0; i < neuron_count; i++) {
+                    for (uint32_t j = neurons[i].first_edge; j < neurons[i].end_edge; j++) {
+                        c.add(neuron_ids[i], neuron_ids[edges[j].to], edges[j].weight,
+                                edges[j].delay);
+                    }
+                }
+
+                return c;
+            }
+
+            // The simulation's state, in the format of risp_snapshot.hpp.
+            // Restoring it into this network, or another instance of it, with
+            // restore() continues the simulation from where it was taken.
+            // Which outputs and neurons are tracked is configuration, not
+            // state: it is not in the snapshot, and restore() leaves the
+            // network's own as it is.
+
+            std::vector<uint8_t> snapshot() const
+            {
+                Snapshot_Writer w(checksum, layout, neuron_count,
+                        std::is_floating_point<charge_t>::value);
+
+                w.put<uint32_t>(overall_run_time);
+                w.put<uint32_t>(run_start);
+
+                for (size_t i = 0; i < neuron_count; i++) {
+
+                    const Neuron & n = neurons[i];
+                    const bool tracked = (n.tracking_epoch == tracking_epoch);
+
+                    put_charge(w, (tracked || n.activity_epoch == activity_epoch) ? n.charge : 0);
+                    w.put<int32_t>(tracked ? n.last_fire : -1);
+                    w.put<uint32_t>(fire_count(n));
+                }
+
+                // Every timestep before overall_run_time has been processed, so
+                // the live buckets are those of the next EVENT_RING_SIZE.
+
+                uint32_t count = 0;
+
+                for (uint32_t k = 0; k < EVENT_RING_SIZE; k++) {
+                    const event_vector_t & ev = events[(overall_run_time + k) & (EVENT_RING_SIZE - 1)];
+                    if (ev.epoch == activity_epoch) count += ev.size;
+                }
+
+                w.put<uint32_t>(count);
+
+                for (uint32_t k = 0; k < EVENT_RING_SIZE; k++) {
+
+                    const uint32_t b = (overall_run_time + k) & (EVENT_RING_SIZE - 1);
+
+                    if (events[b].epoch != activity_epoch) continue;
+
+                    for (uint32_t i = 0; i < events[b].size; i++) {
+                        put_event(w, k, event_arena[b * bucket_size + i]);
+                    }
+                }
+
+                w.put<uint32_t>(far_inputs.size());
+
+                for (size_t i = 0; i < far_inputs.size(); i++) {
+                    put_event(w, far_inputs.time_at(i) - overall_run_time, far_inputs.event_at(i));
+                }
+
+                return w.bytes;
+            }
+
+            // Throws if the snapshot is not of this network, leaving the
+            // activity cleared if it fails after the header.
+
+            void restore(const std::vector<uint8_t> & s)
+            {
+                Snapshot_Reader r(s, checksum, layout, neuron_count,
+                        std::is_floating_point<charge_t>::value);
+
+                clear_activity();
+
+                try {
+                    overall_run_time = r.get<uint32_t>();
+                    run_start = r.get<uint32_t>();
+
+                    for (size_t i = 0; i < neuron_count; i++) {
+
+                        Neuron & n = neurons[i];
+
+                        n.charge = get_charge(r);
+                        n.last_fire = r.get<int32_t>();
+                        n.fire_counts = r.get<uint32_t>();
+                        n.activity_epoch = activity_epoch;
+                        n.tracking_epoch = tracking_epoch;
+                    }
+
+                    // Restored buckets may hold spikes as well as synaptic
+                    // events, so each keeps room for every synapse (bar the
+                    // current one, whose synaptic events are all in).
+
+                    size_t largest = 0;
+
+                    for (uint32_t i = r.get<uint32_t>(); i > 0; i--) {
+
+                        uint32_t offset;
+                        const event_t e = get_event(r, offset);
+
+                        if (offset >= EVENT_RING_SIZE) throw std::runtime_error("snapshot is corrupt");
+
+                        push_event(overall_run_time + offset, e.neuron, e.weight, 0);
+
+                        if (offset > 0) {
+                            largest = std::max<size_t>(largest, bucket(overall_run_time + offset).size);
+                        }
+                    }
+
+                    if (largest + synapse_count > bucket_size) {
+                        grow_buckets(largest + synapse_count);
+                    }
+
+                    for (uint32_t i = r.get<uint32_t>(); i > 0; i--) {
+
+                        uint32_t offset;
+                        const event_t e = get_event(r, offset);
+
+                        far_inputs.append(overall_run_time + offset, e);
+                    }
+
+                    r.finish();
+                }
+                catch (...) {
+                    clear_activity();
+                    throw;
+                }
+            }
+
+            // A new instance of Net in this one's state, tracking the same
+            // outputs and neurons (with an empty log until its next run()).
+
+            Net * clone() const
+            {
+                Net * n = new Net();
+
+                n->restore(snapshot());
+
+                for (size_t o = 0; o < output_neuron_count; o++) {
+                    if (neurons[output_neurons[o]].log) n->track_output_events(o);
+                }
+
+                if (spike_log.get_capacity() != 0) n->set_spike_log_capacity(spike_log.get_capacity());
+
+                for (size_t i = 0; i < neuron_count; i++) n->neurons[i].trace = neurons[i].trace;
+
+                return n;
+            }
+
+        protected:
+
+            typedef Basic_Neuron<T> Neuron;
+            typedef typename T::charge_t charge_t;
+
+            typedef struct {
+
+                typename T::weight_t weight;
+                typename T::delay_t delay;
+                typename T::index_t to;
+
+            } edge_t;
+
+            // Wide enough for the sum of two charges.
+
+            typedef typename std::conditional<std::is_floating_point<charge_t>::value, charge_t,
+                    typename std::conditional<sizeof(charge_t) < sizeof(int), int, int64_t>::type
+                    >::type sum_t;
+
+            Engine()
+                : neuron_count(0),
+                neurons(nullptr),
+                neuron_ids(nullptr),
+                edges(nullptr),
+                edge_ids(nullptr),
+                edge_stddevs(nullptr),
+                output_neurons(nullptr),
+                output_neuron_count(0),
+                bucket_size(0),
+                synapse_count(0),
+                peak_events(0),
+                layout(0),
+                overall_run_time(0),
+                run_start(0),
+                min_potential(0),
+                spike_value_factor(1),
+                input_weights(nullptr),
+                input_weight_count(0),
+                noisy_seed(0),
+                activity_epoch(0),
+                tracking_epoch(0)
+            {
+                memset(events, 0, sizeof(events));
+                occupied.resize(EVENT_RING_SIZE);
+            }
 
             size_t neuron_count;
+            Neuron * neurons;
+            const int * neuron_ids;             // Node ids, by neuron index
+            const edge_t * edges;
+            const uint32_t * edge_ids;          // Index in the network file, and stddev of
+            const float * edge_stddevs;         // its noise, by edge, if P::noisy
+            const uint32_t * output_neurons;
+            size_t output_neuron_count;
 
             typedef struct {
 
-                Neuron * neuron;
-                int weight;
+                typename T::index_t neuron;
+                charge_t weight;
 
             } event_t;
 
+            // A bucket's events are its slice of event_arena (see
+            // bucket_events()).
+
             typedef struct {
 
-                event_t events[Constants::MAX_EVENTS_PER_VECTOR];
-                size_t size;
+                uint32_t size;
+                uint64_t epoch;
 
             } event_vector_t;
 
-            event_vector_t events[Constants::MAX_EVENT_VECTORS];
-
-            int overall_run_time;     
-            bool run_time_inclusive; 
-            bool threshold_inclusive; 
-            int min_potential;    
-            bool discrete;           
-            bool inputs_from_weights; 
-            int spike_value_factor;
-
-            Neuron n0 = Neuron(3);
-            Neuron n1 = Neuron(1);
-            Neuron n2 = Neuron(6);
-            Neuron n3 = Neuron(0);
-            Neuron n4 = Neuron(6);
-            Neuron n5 = Neuron(7);
-            Neuron n6 = Neuron(0);
-            Neuron n7 = Neuron(3);
-            Neuron n8 = Neuron(3);
-            Neuron n9 = Neuron(0);
-            Neuron n10 = Neuron(6);
-            Neuron n11 = Neuron(2);
-            Neuron n12 = Neuron(0);
-            Neuron n13 = Neuron(0);
-            Neuron n15 = Neuron(4);
-            Neuron n16 = Neuron(7);
-            Neuron n17 = Neuron(7);
-            Neuron n18 = Neuron(3);
-            Neuron n20 = Neuron(7);
-            Neuron n22 = Neuron(6);
-            Neuron n26 = Neuron(4);
-            Neuron n30 = Neuron(3);
-            Neuron n32 = Neuron(2);
-            Neuron n33 = Neuron(4);
-            Neuron n34 = Neuron(6);
-            Neuron n41 = Neuron(5);
-            Neuron n42 = Neuron(7);
-            Neuron n51 = Neuron(3);
-            Neuron n60 = Neuron(4);
-            Neuron n62 = Neuron(2);
-            Neuron n64 = Neuron(2);
-            Neuron n67 = Neuron(5);
-            Neuron n68 = Neuron(7);
-            Neuron n77 = Neuron(3);
-            Neuron n80 = Neuron(4);
-            Neuron n88 = Neuron(3);
-            Neuron n93 = Neuron(3);
-            Neuron n95 = Neuron(5);
-            Neuron n101 = Neuron(3);
-            Neuron n102 = Neuron(5);
-
-            Synapse s11_102 = Synapse(&n11, &n102, -7, 9);
-            Synapse s8_34 = Synapse(&n8, &n34, 5, 3);
-            Synapse s12_17 = Synapse(&n12, &n17, 3, 10);
-            Synapse s1_11 = Synapse(&n1, &n11, -6, 12);
-            Synapse s8_2 = Synapse(&n8, &n2, -2, 1);
-            Synapse s13_1 = Synapse(&n13, &n1, 4, 2);
-            Synapse s8_9 = Synapse(&n8, &n9, -2, 14);
-            Synapse s2_8 = Synapse(&n2, &n8, 3, 7);
-            Synapse s13_26 = Synapse(&n13, &n26, -6, 4);
-            Synapse s64_ = Synapse(&n64, &n95, -1, 6);
-            Synapse s20_15 = Synapse(&n20, &n15, 3, 7);
-            Synapse s16_13 = Synapse(&n16, &n13, 3, 8);
-            Synapse s80_34 = Synapse(&n80, &n34, 0, 9);
-            Synapse s60_26 = Synapse(&n60, &n26, 2, 11);
-            Synapse s8_15 = Synapse(&n8, &n15, -3, 6);
-            Synapse s6_9 = Synapse(&n6, &n9, 2, 3);
-            Synapse s77_101 = Synapse(&n77, &n101, 2, 14);
-            Synapse s26_11 = Synapse(&n26, &n11, 2, 1);
-            Synapse s9_20 = Synapse(&n9, &n20, 6, 9);
-            Synapse s0_22 = Synapse(&n0, &n22, -5, 15);
-            Synapse s51_1 = Synapse(&n51, &n1, -7, 1);
-            Synapse s2_77 = Synapse(&n2, &n77, 6, 7);
-            Synapse s1_3 = Synapse(&n1, &n3, 1, 3);
-            Synapse s2_42 = Synapse(&n2, &n42, 1, 2);
-            Synapse s3_16 = Synapse(&n3, &n16, -7, 13);
-            Synapse s32_60 = Synapse(&n32, &n60, -2, 14);
-            Synapse s10_1 = Synapse(&n10, &n1, -2, 3);
-            Synapse s6_10 = Synapse(&n6, &n10, 0, 3);
-            Synapse s16_62 = Synapse(&n16, &n62, 0, 1);
-            Synapse s102_30 = Synapse(&n102, &n30, -3, 11);
-            Synapse s60_10 = Synapse(&n60, &n10, 6, 9);
-            Synapse s32_34 = Synapse(&n32, &n34, 1, 1);
-            Synapse s32_2 = Synapse(&n32, &n2, -4, 14);
-            Synapse s30_32 = Synapse(&n30, &n32, 0, 9);
-            Synapse s13_3 = Synapse(&n13, &n3, 5, 3);
-            Synapse s26_77 = Synapse(&n26, &n77, 1, 15);
-            Synapse s64_13 = Synapse(&n64, &n13, -2, 12);
-            Synapse s2_67 = Synapse(&n2, &n67, 2, 14);
-            Synapse s11_8 = Synapse(&n11, &n8, -7, 8);
-            Synapse s5_95 = Synapse(&n5, &n95, 4, 9);
-            Synapse s30_80 = Synapse(&n30, &n80, 5, 5);
-            Synapse s9_51 = Synapse(&n9, &n51, -5, 12);
-            Synapse s51_8 = Synapse(&n51, &n8, 1, 15);
-            Synapse s0_1 = Synapse(&n0, &n1, -4, 3);
-            Synapse s11_6 = Synapse(&n11, &n6, 3, 14);
-            Synapse s101_26 = Synapse(&n101, &n26, 2, 2);
-            Synapse s4_93 = Synapse(&n4, &n93, 1, 4);
-            Synapse s1_17 = Synapse(&n1, &n17, -3, 14);
-            Synapse s9_4 = Synapse(&n9, &n4, -1, 7);
-            Synapse s95_60 = Synapse(&n95, &n60, 6, 8);
-            Synapse s1_30 = Synapse(&n1, &n30, 1, 13);
-            Synapse s17_102 = Synapse(&n17, &n102, 4, 1);
-            Synapse s6_26 = Synapse(&n6, &n26, 6, 2);
-            Synapse s0_26 = Synapse(&n0, &n26, 7, 1);
-            Synapse s4_0 = Synapse(&n4, &n0, 2, 15);
-            Synapse s2_3 = Synapse(&n2, &n3, 2, 9);
-            Synapse s101_10 = Synapse(&n101, &n10, 1, 4);
-            Synapse s51_11 = Synapse(&n51, &n11, 0, 14);
-            Synapse s8_51 = Synapse(&n8, &n51, 7, 5);
-            Synapse s10_68 = Synapse(&n10, &n68, 1, 4);
-            Synapse s4_33 = Synapse(&n4, &n33, 1, 6);
-            Synapse s8_0 = Synapse(&n8, &n0, 0, 4);
-            Synapse s0_13 = Synapse(&n0, &n13, 3, 8);
-            Synapse s68_12 = Synapse(&n68, &n12, -2, 13);
-            Synapse s12_80 = Synapse(&n12, &n80, -4, 3);
-            Synapse s4_4 = Synapse(&n4, &n4, 5, 3);
-            Synapse s5_93 = Synapse(&n5, &n93, 7, 12);
-            Synapse s9_77 = Synapse(&n9, &n77, -2, 15);
-            Synapse s1_2 = Synapse(&n1, &n2, -1, 6);
-            Synapse s6_8 = Synapse(&n6, &n8, 3, 12);
-            Synapse s11_7 = Synapse(&n11, &n7, -2, 5);
-            Synapse s80_32 = Synapse(&n80, &n32, 1, 11);
-            Synapse s9_26 = Synapse(&n9, &n26, 5, 4);
-            Synapse s15_10 = Synapse(&n15, &n10, 1, 10);
-            Synapse s33_30 = Synapse(&n33, &n30, 4, 9);
-            Synapse s6_88 = Synapse(&n6, &n88, -6, 15);
-            Synapse s93_12 = Synapse(&n93, &n12, 1, 1);
-            Synapse s88_10 = Synapse(&n88, &n10, 2, 14);
-            Synapse s18_41 = Synapse(&n18, &n41, -3, 8);
-            Synapse s0_18 = Synapse(&n0, &n18, 4, 14);
-            Synapse s11_41 = Synapse(&n11, &n41, 2, 12);
-            Synapse s6_51 = Synapse(&n6, &n51, -1, 10);
-            Synapse s30_101 = Synapse(&n30, &n101, -5, 14);
-            Synapse s13_4 = Synapse(&n13, &n4, 3, 15);
-            Synapse s60_17 = Synapse(&n60, &n17, -4, 8);
-            Synapse s80_10 = Synapse(&n80, &n10, 3, 6);
-            Synapse s102_1 = Synapse(&n102, &n1, 7, 8);
-            Synapse s12_8 = Synapse(&n12, &n8, 0, 12);
-            Synapse s5_13 = Synapse(&n5, &n13, 2, 1);
-            Synapse s20_95 = Synapse(&n20, &n95, 2, 8);
-            Synapse s42_5 = Synapse(&n42, &n5, 4, 6);
-            Synapse s7_32 = Synapse(&n7, &n32, 1, 11);
-            Synapse s33_51 = Synapse(&n33, &n51, -5, 15);
-            Synapse s67_102 = Synapse(&n67, &n102, 3, 10);
-            Synapse s41_77 = Synapse(&n41, &n77, 6, 6);
-            Synapse s60_93 = Synapse(&n60, &n93, -6, 12);
-            Synapse s77_95 = Synapse(&n77, &n95, 3, 8);
-            Synapse s80_26 = Synapse(&n80, &n26, -3, 6);
-            Synapse s17_0 = Synapse(&n17, &n0, 2, 10);
-            Synapse s60_0 = Synapse(&n60, &n0, -5, 9);
-            Synapse s62_4 = Synapse(&n62, &n4, 7, 5);
-            Synapse s68_11 = Synapse(&n68, &n11, 6, 7);
-            Synapse s9_2 = Synapse(&n9, &n2, 0, 4);
-            Synapse s0_95 = Synapse(&n0, &n95, -2, 14);
-            Synapse s34_7 = Synapse(&n34, &n7, 1, 10);
-            Synapse s64_3 = Synapse(&n64, &n3, 4, 14);
-            Synapse s9_67 = Synapse(&n9, &n67, -5, 3);
-            Synapse s22_64 = Synapse(&n22, &n64, -1, 13);
-            Synapse s10_41 = Synapse(&n10, &n41, -7, 15);
-            Synapse s67_9 = Synapse(&n67, &n9, 5, 13);
-            Synapse s51_34 = Synapse(&n51, &n34, -4, 14);
-            Synapse s2_6 = Synapse(&n2, &n6, 3, 14);
-            Synapse s51_60 = Synapse(&n51, &n60, 0, 12);
-
-            static void add_synapse(
-                    Neuron * from, Neuron * to, int weight, uint32_t delay) 
-            {
-                synapse_t * syn = &from->synapses[from->synapse_count];
-
-                syn->to = to;
-                syn->delay = delay;
-                syn->weight = weight;
-
-                from->synapse_count++;
-            }
-
-            static void connect_synapse(Synapse * syn)
-            {
-                Neuron * from = syn->from;
-
-                if (!from->synapse_list_head) {
-                    from->synapse_list_head = syn;
+            static const uint32_t EVENT_RING_SIZE = ring_size(MAX_DELAY + 1);
+
+            event_vector_t events[EVENT_RING_SIZE];
+            std::vector<event_t> event_arena;
+            size_t bucket_size;                 // Events each bucket can hold
+            size_t synapse_count;
+            size_t peak_events;
+
+            Input_Queue<event_t> far_inputs;
+
+            Ring_Occupancy occupied;
+
+            std::vector<Neuron *> touched;      // Sized to hold every neuron
+
+            Topology_Checksum checksum;         // Of the edge table, and
+            uint64_t layout;                    // of neuron_ids, for snapshots
+
+            Output_Log output_log;
+            Spike_Log spike_log;
+
+            uint32_t overall_run_time;
+            uint32_t run_start;
+            charge_t min_potential;
+            double spike_value_factor;
+            const charge_t * input_weights;      // The weights param, if P::inputs_from_weights
+            size_t input_weight_count;
+            uint64_t noisy_seed;
+            uint64_t activity_epoch;
+            uint64_t tracking_epoch;
+
+            Net * net()
+            {
+                return static_cast<Net *>(this);
+            }
+
+            static bool leaks(const Neuron * n)
+            {
+                return P::leak_mode == LEAK_ALL || (P::leak_mode == LEAK_CONFIGURABLE && n->leak);
+            }
+
+            static bool fires(const Neuron * n)
+            {
+                return P::threshold_inclusive ? n->charge >= n->threshold : n->charge > n->threshold;
+            }
+
+            void reset_neuron(Neuron & n)
+            {
+                n.refresh(activity_epoch, tracking_epoch);
+
+                if (leaks(&n)) {
+                    n.charge = 0;
                 }
-                else {
-                    from->synapse_list_tail->next = syn;
+
+                if (n.charge < min_potential) {
+                    n.charge = min_potential;
                 }
+            }
+
+            // A bucket left over from before the last clear_activity() is
+            // emptied here.  So may be its occupancy bit, which at worst costs
+            // one no-op visit from run().
 
-                from->synapse_list_tail = syn;
+            event_vector_t & bucket(const uint32_t time)
+            {
+                event_vector_t & ev = events[time & (EVENT_RING_SIZE - 1)];
+
+                if (ev.epoch != activity_epoch) {
+                    ev.size = 0;
+                    ev.epoch = activity_epoch;
+                }
+
+                return ev;
             }
 
-            void process_events(uint32_t time) 
+            event_t * bucket_events(const uint32_t time)
             {
-                event_vector_t es = events[time];
+                return &event_arena[(time & (EVENT_RING_SIZE - 1)) * bucket_size];
+            }
 
-                for (size_t i = 0; i < es.size; i++) {
+            // A timestep's synaptic events come from distinct synapses, since
+            // each neuron fires at most once per timestep and each synapse has
+            // one delay, so there are at most synapses of them in any bucket.
+            // The buckets hold that many plus one spike per input.  The
+            // generator calls this from Net's constructor.
 
-                    Neuron * n = es.events[i].neuron;
-                    if (n->leak) {
-                        n->charge = 0;
-                    }
-                    if (n->charge < min_potential) {
-                        n->charge = min_potential;
+            void allocate_events(const size_t synapses, const size_t inputs)
+            {
+                synapse_count = synapses;
+                touched.resize(neuron_count);
+                checksum = topology_checksum();
+                layout = Topology_Checksum::layout(neuron_ids, neuron_count);
+                grow_buckets(synapses + inputs);
+            }
+
+            // Resizes the buckets to hold at least size events (at least
+            // doubling them), moving the live events of every bucket to its
+            // new slice.
+
+            void grow_buckets(const size_t size)
+            {
+                const size_t n = std::max(std::max(size, 2 * bucket_size), (size_t) 1);
+
+                std::vector<event_t> arena(EVENT_RING_SIZE * n);
+
+                for (uint32_t b = 0; b < EVENT_RING_SIZE; b++) {
+                    if (events[b].epoch == activity_epoch) {
+                        std::copy(&event_arena[b * bucket_size],
+                                &event_arena[b * bucket_size] + events[b].size, &arena[b * n]);
                     }
                 }
 
-                for (size_t i = 0; i < es.size; i++) {
-                    Neuron * n = es.events[i].neuron;
-                    n->check = true;
-                    n->charge += es.events[i].weight;
+                event_arena.swap(arena);
+                bucket_size = n;
+            }
+
+            // Charges and weights are int32 in snapshots, or float32 if
+            // charge_t is a float.
+
+            static void put_charge(Snapshot_Writer & w, const charge_t c)
+            {
+                if (std::is_floating_point<charge_t>::value) {
+                    w.put<float>(c);
                 }
+                else {
+                    w.put<int32_t>(c);
+                }
+            }
 
-                for (size_t i = 0; i < es.size; i++) {
+            static charge_t get_charge(Snapshot_Reader & r)
+            {
+                if (std::is_floating_point<charge_t>::value) return r.get<float>();
 
-                    Neuron * n = es.events[i].neuron;
+                return saturate(r.get<int32_t>());
+            }
 
-                    if (n->check == true) {
+            static void put_event(Snapshot_Writer & w, const uint32_t offset, const event_t & e)
+            {
+                w.put<uint32_t>(offset);
+                w.put<uint32_t>(e.neuron);
+                put_charge(w, e.weight);
+            }
 
-                        if (n->charge >= n->threshold) {
+            event_t get_event(Snapshot_Reader & r, uint32_t & offset) const
+            {
+                event_t e;
 
-                            new_forward_pass_activation(n, time);
+                offset = r.get<uint32_t>();
 
-                            n->perform_fire(time);
-                        }
+                const uint32_t neuron = r.get<uint32_t>();
 
-                        n->check = false;
-                    }
+                if (neuron >= neuron_count) throw std::runtime_error("snapshot is corrupt");
+
+                e.neuron = neuron;
+                e.weight = get_charge(r);
+
+                return e;
+            }
+
+            uint32_t fire_count(const Neuron & n) const
+            {
+                return (n.tracking_epoch == tracking_epoch) ? n.fire_counts : 0;
+            }
+
+            // Spikes are the only events pushed here.  Each keeps room in its
+            // bucket for the synaptic events still to come: one per synapse,
+            // or none once every timestep before the bucket's has run.
+
+            void push_event(const uint32_t time, const uint32_t neuron, const charge_t weight,
+                    const size_t room)
+            {
+                event_vector_t & ev = bucket(time);
+
+                if (__builtin_expect(ev.size + room >= bucket_size, 0)) {
+                    grow_buckets(ev.size + room + 1);
                 }
+
+                event_t & e = bucket_events(time)[ev.size];
+
+                e.neuron = neuron;
+                e.weight = weight;
+
+                ev.size++;
+
+                occupied.set(time);
             }
 
-            void new_forward_pass_activation(Neuron * n, const uint32_t time)
+            // The first timestep from time on (before overall_run_time) with a
+            // non-empty bucket or a far input due, or overall_run_time if none.
+
+            uint32_t next_event_time(const uint32_t time) const
             {
-                for (Synapse * s=n->synapse_list_head; s; s=s->next) {
+                uint32_t t = time + occupied.next(time, overall_run_time - time);
+
+                if (!far_inputs.empty() && far_inputs.next_time() < t) {
+                    t = std::max(far_inputs.next_time(), time);
+                }
+
+                return t;
+            }
+
+            // One pass over the live bucket brings each neuron's charge up to
+            // date the first time it is touched (leak, min_potential), adds the
+            // event's weight, and records the neuron in touched.  Then each
+            // touched neuron is checked against its threshold exactly once.
+            //
+            // Float charges (RISP-F) take this same path, and it is not
+            // vectorized: the adds are a scatter through event neuron indices
+            // that may repeat within a bucket, and the first touch of each
+            // neuron is conditional, so -fopt-info-vec reports the loop as
+            // missed ("unsupported use in stmt").  Vectorizing it would need
+            // conflict detection, which GCC does not generate.
+
+            void process_events(uint32_t time)
+            {
+                while (far_inputs.ready(time)) {
+                    const event_t e = far_inputs.pop();
+                    push_event(time, e.neuron, e.weight, 0);
+                }
+
+                event_vector_t & es = bucket(time);
+                const event_t * const ev = bucket_events(time);
+                Neuron * const ns = neurons;
+                Neuron ** const ts = touched.data();
+
+                size_t touched_count = 0;
+
+                if (es.size > peak_events) peak_events = es.size;
+
+                for (size_t i = 0; i < es.size; i++) {
+
+                    Neuron * n = &ns[ev[i].neuron];
 
-                    size_t to_time = time + s->delay;
+                    if (!n->check) {
 
-                    int weight = s->weight;
+                        n->refresh(activity_epoch, tracking_epoch);
 
-                    const size_t size = events[to_time].size;
+                        if (leaks(n)) {
+                            n->charge = 0;
+                        }
+                        if (n->charge < min_potential) {
+                            n->charge = min_potential;
+                        }
 
-                    events[to_time].events[size].neuron = s->to;
-                    events[to_time].events[size].weight = weight;
+                        n->check = true;
+                        ts[touched_count++] = n;
+                    }
 
-                    events[to_time].size++;
+                    n->charge = saturate((sum_t) n->charge + ev[i].weight);
                 }
+
+                es.size = 0;
+
+                occupied.reset(time);
+
+                for (size_t i = 0; i < touched_count; i++) {
+
+                    Neuron * n = ts[i];
+
+                    n->check = false;
+
+                    if (fires(n)) {
+
+                        forward_pass_activation(n, time);
+
+                        n->perform_fire(time - run_start);
+
+                        if (__builtin_expect(n->log, 0)) {
+                            output_log.record(n - ns, time - run_start, tracking_epoch);
+                        }
+
+                        spike_log.append(n - ns, time - run_start, n->trace);
+                    }
+                }
+            }
+
+            // A value clamped to an integer charge_t, which is exact whenever
+            // it fits.  The generator sizes charge_t so that a timestep's
+            // synaptic input always does; only piled-up or outsized input
+            // spikes saturate.  Float charges are passed through.
+
+            template <class V> static charge_t saturate(const V v)
+            {
+                if (std::is_floating_point<charge_t>::value) return (charge_t) v;
+
+                return (charge_t) std::min<V>(std::max<V>(v, std::numeric_limits<charge_t>::lowest()),
+                        std::numeric_limits<charge_t>::max());
             }
 
-             void forward_pass_activation(Neuron * n, const uint32_t time)
+            // A neuron's edges are sorted by delay, so each run of equal delays
+            // is appended to its bucket in one go, with one size update and
+            // one occupancy bit.  The table pointers are copied to locals,
+            // since event weights may be chars, which the compiler must assume
+            // alias them.
+
+            void forward_pass_activation(Neuron * n, const uint32_t time)
             {
-                for (size_t j = 0; j < n->synapse_count; j++) {
+                const edge_t * const es = edges;
+                const uint32_t end = n->end_edge;
+
+                for (uint32_t j = n->first_edge; j < end; ) {
+
+                    const uint32_t delay = es[j].delay;
+                    event_vector_t & ev = bucket(time + delay);
+                    event_t * out = bucket_events(time + delay) + ev.size;
 
-                    synapse_t * syn = &n->synapses[j];
+                    do {
+                        const edge_t & e = es[j];
 
-                    size_t to_time = time + syn->delay;
+                        out->neuron = e.to;
+
+                        if (P::noisy) {
+                            out->weight = saturate(Noise::weight(e.weight, edge_stddevs[j],
+                                        std::is_integral<charge_t>::value, noisy_seed,
+                                        edge_ids[j], time));
+                        }
+                        else {
+                            out->weight = e.weight;
+                        }
 
-                    int weight = syn->weight;
+                        out++;
+                        j++;
 
-                    const size_t size = events[to_time].size;
+                    } while (j < end && es[j].delay == delay);
 
-                    events[to_time].events[size].neuron = syn->to;
-                    events[to_time].events[size].weight = weight;
+                    ev.size = out - bucket_events(time + delay);
 
-                    events[to_time].size++;
+                    occupied.set(time + delay);
                 }
             }
 
-            void clear_tracking_info()
+            // A spike's weight.  With P::inputs_from_weights, the value indexes
+            // the weights param; otherwise normalized values are scaled by
+            // spike_value_factor.
+
+            charge_t input_weight(const double value, const bool normalized) const
             {
-                n0.clear_tracking_info();
-                n1.clear_tracking_info();
-                n2.clear_tracking_info();
-                n3.clear_tracking_info();
-                n4.clear_tracking_info();
-                n5.clear_tracking_info();
-                n6.clear_tracking_info();
-                n7.clear_tracking_info();
-                n8.clear_tracking_info();
-                n9.clear_tracking_info();
-                n10.clear_tracking_info();
-                n11.clear_tracking_info();
-                n12.clear_tracking_info();
-                n13.clear_tracking_info();
-                n15.clear_tracking_info();
-                n16.clear_tracking_info();
-                n17.clear_tracking_info();
-                n18.clear_tracking_info();
-                n20.clear_tracking_info();
-                n22.clear_tracking_info();
-                n26.clear_tracking_info();
-                n30.clear_tracking_info();
-                n32.clear_tracking_info();
-                n33.clear_tracking_info();
-                n34.clear_tracking_info();
-                n41.clear_tracking_info();
-                n42.clear_tracking_info();
-                n51.clear_tracking_info();
-                n60.clear_tracking_info();
-                n62.clear_tracking_info();
-                n64.clear_tracking_info();
-                n67.clear_tracking_info();
-                n68.clear_tracking_info();
-                n77.clear_tracking_info();
-                n80.clear_tracking_info();
-                n88.clear_tracking_info();
-                n93.clear_tracking_info();
-                n95.clear_tracking_info();
-                n101.clear_tracking_info();
-                n102.clear_tracking_info();
+                if (P::inputs_from_weights) {
+                    if (value < 0 || value >= input_weight_count || value != (int) value) {
+                        throw std::runtime_error("spike value is not an index into weights");
+                    }
+                    return input_weights[(int) value];
+                }
+
+                if (normalized && (value < -1 || value > 1)) {
+                    throw std::runtime_error("spike value must be >= -1 and <= 1");
+                }
+
+                return saturate(normalized ? value * spike_value_factor : value);
             }
 
-            void apply_spike_input(Neuron * neuron, const size_t time)
+            // time is relative to the current timestep.  Spikes that the ring
+            // can't hold yet wait in far_inputs.
+
+            void apply_spike_input(Neuron * neuron, const int time, const double value,
+                    const bool normalized)
             {
-                const size_t size = events[time].size;
+                const charge_t weight = input_weight(value, normalized);
+                const uint32_t index = neuron - neurons;
 
-                events[time].events[size].neuron = neuron;
-                events[time].events[size].weight = spike_value_factor;
+                if (time < 0) {
+                    throw std::runtime_error("spike time must be non-negative");
+                }
 
-                events[time].size++;
+                if ((uint32_t) time < EVENT_RING_SIZE) {
+                    push_event(overall_run_time + time, index, weight,
+                            (time == 0) ? 0 : synapse_count);
+                }
+                else {
+                    event_t e;
+                    e.neuron = index;
+                    e.weight = weight;
+                    far_inputs.push(overall_run_time + time, e);
+                }
             }
 
-            static void debug_neuron(Neuron * n)
+            size_t neuron_index(const int id) const
             {
-                size_t count = 0;
-                for (Synapse *s=n->synapse_list_head; s; s=s->next) {
-                    count++;
+                for (size_t i = 0; i < neuron_count; i++) {
+                    if (neuron_ids[i] == id) return i;
                 }
 
-                printf("%p: %lu %lu\n", n, count, n->synapse_count);
+                char buf[64];
+                snprintf(buf, sizeof(buf), "%d is not a neuron", id);
+                throw std::runtime_error(buf);
+            }
+
+            void debug_neuron(Neuron * n) const
+            {
+                const size_t i = n - neurons;
+
+                printf("%p: n%d %u\n", n, neuron_ids[i], n->end_edge - n->first_edge);
             }
 
     };
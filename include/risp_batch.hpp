@@ -0,0 +1,538 @@
+#pragma once
+
+// Runs LANES independent input streams through one RISP network in lockstep.
+// Every neuron's charge and tracking state is a vector of LANES values, one
+// per stream, and a bucket entry says which lanes a neuron received events
+// in.  So a neuron's threshold check is one loop over its lanes, and a fire
+// walks the neuron's synapses once for all the lanes that fired.  Given the
+// same inputs, each lane's output counts and last fires are those of a
+// risp::Runtime_Network; the batch has none of its output and neuron
+// tracking, snapshots or charge reports, and it refuses non-discrete
+// networks and weights beyond 16 bits.
+//
+// All lanes share the clock: run() advances them together, and
+// clear_activity() clears them together, by epoch as in risp::Engine.
+
+#include <stdint.h>
+#include <stdio.h>
+
+#include <algorithm>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "risp_inputs.hpp"
+#include "risp_noise.hpp"
+#include "risp_spec.hpp"
+
+namespace risp
+{
+    typedef struct {
+
+        uint32_t lane;
+        int id;
+        int time;
+        double value;
+        bool normalized;
+
+    } lane_spike_t;
+
+    template <uint32_t LANES> class Batch_Network {
+
+        static_assert(LANES >= 1 && LANES <= 64, "lanes must fit in a 64-bit mask");
+
+        public:
+
+            Batch_Network(const std::string & network_file, const std::string & params_file = "")
+            {
+                Network_Spec spec;
+
+                spec.load(network_file, params_file);
+
+                load(spec);
+            }
+
+            Batch_Network(const Network_Spec & spec)
+            {
+                load(spec);
+            }
+
+            static uint32_t lanes()
+            {
+                return LANES;
+            }
+
+            // Spike values are as in risp::Engine::input_weight().
+
+            void apply_spike(const uint32_t lane, const int id, const int time,
+                    const double value = 1, const bool normalized = true)
+            {
+                const uint32_t n = input_index(id);
+                const int weight = input_weight(value, normalized);
+
+                if (lane >= LANES) {
+                    throw std::runtime_error("lane out of range");
+                }
+
+                if (time < 0) {
+                    throw std::runtime_error("spike time must be non-negative");
+                }
+
+                if ((uint32_t) time <= ring_mask) {
+                    push_event(overall_run_time + time, n, (uint64_t) 1 << lane, weight);
+                }
+                else {
+                    event_t e;
+                    e.neuron = n;
+                    e.lane = lane;
+                    e.weight = weight;
+                    far_inputs.push(overall_run_time + time, e);
+                }
+            }
+
+            void apply_spikes(const std::vector<lane_spike_t> & spikes)
+            {
+                for (size_t i = 0; i < spikes.size(); i++) {
+                    apply_spike(spikes[i].lane, spikes[i].id, spikes[i].time, spikes[i].value,
+                            spikes[i].normalized);
+                }
+            }
+
+            void run(int timesteps)
+            {
+                if (overall_run_time != 0) {
+                    tracking_epoch++;
+                }
+
+                if (timesteps <= 0 && !run_time_inclusive) return;
+
+                const size_t run_time = (run_time_inclusive) ? timesteps : timesteps-1;
+
+                run_start = overall_run_time;
+
+                overall_run_time += (run_time+1);
+
+                // Only timesteps with events (or inputs due) are processed.
+
+                for (uint32_t t = next_event_time(run_start); t < overall_run_time;
+                        t = next_event_time(t + 1)) {
+                    process_events(t);
+                }
+
+                reset_neurons();
+            }
+
+            void clear_activity()
+            {
+                activity_epoch++;
+                tracking_epoch++;
+
+                far_inputs.clear();
+                occupied.clear();
+
+                overall_run_time = 0;
+            }
+
+            uint32_t get_time() const
+            {
+                return overall_run_time;
+            }
+
+            size_t num_outputs() const
+            {
+                return outputs.size();
+            }
+
+            uint32_t output_count(const uint32_t lane, const size_t o) const
+            {
+                const uint32_t n = outputs[o];
+
+                return (tracking_stamp[n] == tracking_epoch) ? fire_counts[n * LANES + lane] : 0;
+            }
+
+            // Output o's fire counts for every lane, LANES values.
+
+            void output_counts(const size_t o, uint32_t * counts) const
+            {
+                for (uint32_t l = 0; l < LANES; l++) counts[l] = output_count(l, o);
+            }
+
+            int output_last_fire(const uint32_t lane, const size_t o) const
+            {
+                const uint32_t n = outputs[o];
+
+                return (tracking_stamp[n] == tracking_epoch) ? last_fire[n * LANES + lane] : -1;
+            }
+
+        private:
+
+            typedef struct {
+
+                uint32_t to;
+                int16_t weight;
+                uint16_t delay;
+
+            } synapse_t;
+
+            typedef struct {
+
+                uint32_t neuron;
+                uint32_t lane;
+                int weight;
+
+            } event_t;
+
+            // One timestep's events: for each neuron, the lanes that received
+            // any (lanes) and the summed weights per lane (weight, LANES per
+            // neuron).  neurons lists the neurons with any lane set, so that
+            // processing a bucket doesn't sweep the whole network.
+
+            typedef struct {
+
+                std::vector<uint64_t> lanes;
+                std::vector<int> weight;
+                std::vector<uint32_t> neurons;
+                uint64_t epoch;
+
+            } bucket_t;
+
+            // Topology
+
+            std::vector<int> ids;
+            std::vector<int> threshold;
+            std::vector<uint8_t> leak;
+            std::vector<uint32_t> offsets;
+            std::vector<synapse_t> synapses;
+            std::vector<uint32_t> synapse_id;       // Index in the network file, and stddev
+            std::vector<float> synapse_stddev;      // of its noise, if noisy
+            std::vector<uint32_t> inputs;
+            std::vector<uint32_t> outputs;
+            std::vector<int> input_weights; // The weights param, if inputs_from_weights
+
+            // State, LANES entries per neuron
+
+            std::vector<int> charge;
+            std::vector<int> last_fire;
+            std::vector<uint32_t> fire_counts;
+            std::vector<uint64_t> stamp;            // Per neuron, as in Runtime_Network
+            std::vector<uint64_t> tracking_stamp;
+            std::vector<bucket_t> buckets;
+            uint32_t ring_mask;
+            Input_Queue<event_t> far_inputs;
+            Ring_Occupancy occupied;
+
+            uint32_t overall_run_time;
+            uint32_t run_start;
+            bool run_time_inclusive;
+            int min_potential;
+            int spike_value_factor;
+            bool noisy;
+            uint64_t noisy_seed;
+            uint64_t activity_epoch;
+            uint64_t tracking_epoch;
+
+            static int integer(const double v, const char * what)
+            {
+                if (v != (double) (int) v) {
+                    throw std::runtime_error((std::string) what + " is not an integer");
+                }
+                return (int) v;
+            }
+
+            void load(const Network_Spec & spec)
+            {
+                const Params & p = spec.params;
+
+                if (!p.discrete) {
+                    throw std::runtime_error("Batch_Network is integer-only (discrete must be true)");
+                }
+
+                overall_run_time = 0;
+                run_start = 0;
+                activity_epoch = 0;
+                tracking_epoch = 0;
+                run_time_inclusive = p.run_time_inclusive;
+                min_potential = integer(p.min_potential, "min_potential");
+                spike_value_factor = integer(p.spike_value_factor, "spike_value_factor");
+                noisy = p.noisy();
+                noisy_seed = p.noisy_seed;
+
+                const size_t n = spec.nodes.size();
+
+                for (size_t i = 0; i < n; i++) {
+                    ids.push_back(spec.nodes[i].id);
+                    threshold.push_back(integer(spec.nodes[i].threshold, "threshold") +
+                            (p.threshold_inclusive ? 0 : 1));       // As in Runtime_Network
+                    leak.push_back(spec.nodes[i].leak);
+                }
+
+                // Counting sort of the edges by source neuron, as in Runtime_Network.
+
+                offsets.assign(n+1, 0);
+
+                for (size_t i = 0; i < spec.edges.size(); i++) {
+                    offsets[spec.node_index(spec.edges[i].from) + 1]++;
+                }
+
+                for (size_t i = 0; i < n; i++) {
+                    offsets[i+1] += offsets[i];
+                }
+
+                std::vector<uint32_t> next(offsets.begin(), offsets.end() - 1);
+
+                synapses.resize(spec.edges.size());
+                synapse_id.resize(spec.edges.size());
+                synapse_stddev.resize(spec.edges.size());
+
+                for (size_t i = 0; i < spec.edges.size(); i++) {
+
+                    const Edge_Spec & e = spec.edges[i];
+                    const int w = integer(e.weight, "weight");
+
+                    if (w < INT16_MIN || w > INT16_MAX || e.delay > UINT16_MAX) {
+                        throw std::runtime_error("weight or delay too large for Batch_Network");
+                    }
+
+                    const uint32_t j = next[spec.node_index(e.from)]++;
+                    synapse_t & s = synapses[j];
+
+                    synapse_id[j] = i;
+                    synapse_stddev[j] = e.stddev;
+
+                    s.to = spec.node_index(e.to);
+                    s.weight = w;
+                    s.delay = e.delay;
+                }
+
+                for (size_t i = 0; i < spec.inputs.size(); i++) {
+                    inputs.push_back(spec.node_index(spec.inputs[i]));
+                }
+
+                if (p.inputs_from_weights) {
+                    for (size_t i = 0; i < p.weights.size(); i++) {
+                        input_weights.push_back(integer(p.weights[i], "weight"));
+                    }
+                }
+
+                for (size_t i = 0; i < spec.outputs.size(); i++) {
+                    outputs.push_back(spec.node_index(spec.outputs[i]));
+                }
+
+                buckets.resize(ring_size(spec.max_edge_delay() + 1));
+                ring_mask = buckets.size() - 1;
+                occupied.resize(buckets.size());
+
+                for (size_t i = 0; i < buckets.size(); i++) {
+                    buckets[i].lanes.assign(n, 0);
+                    buckets[i].weight.assign(n * LANES, 0);
+                    buckets[i].epoch = 0;
+                }
+
+                charge.assign(n * LANES, 0);
+                last_fire.assign(n * LANES, -1);
+                fire_counts.assign(n * LANES, 0);
+                stamp.assign(n, 0);
+                tracking_stamp.assign(n, 0);
+            }
+
+            uint32_t input_index(const int id) const
+            {
+                for (size_t i = 0; i < inputs.size(); i++) {
+                    if (ids[inputs[i]] == id) {
+                        return inputs[i];
+                    }
+                }
+
+                char buf[64];
+                snprintf(buf, sizeof(buf), "%d is not an input neuron", id);
+                throw std::runtime_error(buf);
+            }
+
+            // As in Runtime_Network.
+
+            int input_weight(const double value, const bool normalized) const
+            {
+                if (!input_weights.empty()) {
+                    if (value < 0 || value >= input_weights.size() || value != (int) value) {
+                        throw std::runtime_error("spike value is not an index into weights");
+                    }
+                    return input_weights[(int) value];
+                }
+
+                if (normalized && (value < -1 || value > 1)) {
+                    throw std::runtime_error("spike value must be >= -1 and <= 1");
+                }
+
+                return (int) (normalized ? value * spike_value_factor : value);
+            }
+
+            void push_event(const uint32_t time, const uint32_t neuron, const uint64_t lane_bit,
+                    const int weight)
+            {
+                bucket_t & b = bucket(time);
+
+                if (b.lanes[neuron] == 0) b.neurons.push_back(neuron);
+
+                occupied.set(time);
+
+                b.lanes[neuron] |= lane_bit;
+                b.weight[neuron * LANES + __builtin_ctzll(lane_bit)] += weight;
+            }
+
+            // The per-lane version of Runtime_Network::process_events(): lanes
+            // that received events are brought up to date (leak, min_potential),
+            // get their summed weight, and are checked against the threshold.
+            // The lane loops are branch-free so that they vectorize.
+
+            void process_events(const uint32_t time)
+            {
+                while (far_inputs.ready(time)) {
+                    const event_t e = far_inputs.pop();
+                    push_event(time, e.neuron, (uint64_t) 1 << e.lane, e.weight);
+                }
+
+                bucket_t & b = bucket(time);
+
+                for (size_t i = 0; i < b.neurons.size(); i++) {
+
+                    const uint32_t n = b.neurons[i];
+
+                    refresh(n);
+
+                    const uint64_t touched = b.lanes[n];
+                    const int thr = threshold[n];
+                    const int keep = leak[n] ? 0 : -1;
+
+                    int * const c = &charge[n * LANES];
+                    int * const w = &b.weight[n * LANES];
+                    uint64_t fired = 0;
+
+                    b.lanes[n] = 0;
+
+                    for (uint32_t l = 0; l < LANES; l++) {
+
+                        const int t = -(int) ((touched >> l) & 1);
+                        const int v = std::max(c[l] & keep, min_potential) + w[l];
+                        const int f = -(int) (v >= thr) & t;
+
+                        c[l] = (c[l] & ~t) | (v & t & ~f);
+                        fired |= (uint64_t) (f & 1) << l;
+                        w[l] = 0;
+                    }
+
+                    if (fired == 0) continue;
+
+                    for (uint64_t f = fired; f != 0; f &= f - 1) {
+                        const uint32_t l = __builtin_ctzll(f);
+                        last_fire[n * LANES + l] = time - run_start;
+                        fire_counts[n * LANES + l]++;
+                    }
+
+                    forward_pass_activation(n, fired, time);
+                }
+
+                b.neurons.clear();
+                occupied.reset(time);
+            }
+
+            // The first timestep from time on (before overall_run_time) with a
+            // non-empty bucket or a far input due, or overall_run_time if none.
+
+            uint32_t next_event_time(const uint32_t time) const
+            {
+                uint32_t t = time + occupied.next(time, overall_run_time - time);
+
+                if (!far_inputs.empty() && far_inputs.next_time() < t) {
+                    t = std::max(far_inputs.next_time(), time);
+                }
+
+                return t;
+            }
+
+            // Synapse j's weight when it fires at time: with noise, if noisy.
+            // Noise is keyed by the synapse's index in the network file, so
+            // every lane gets the same weight.
+
+            int synapse_weight(const uint32_t j, const uint32_t time) const
+            {
+                if (!noisy) return synapses[j].weight;
+
+                const double w = Noise::weight(synapses[j].weight, synapse_stddev[j], true,
+                        noisy_seed, synapse_id[j], time);
+
+                return (int) std::max(std::min(w, (double) INT16_MAX), (double) INT16_MIN);
+            }
+
+            void forward_pass_activation(const uint32_t n, const uint64_t fired, const uint32_t time)
+            {
+                for (uint32_t j = offsets[n]; j < offsets[n+1]; j++) {
+
+                    const synapse_t & s = synapses[j];
+                    const int sw = synapse_weight(j, time);
+                    bucket_t & b = bucket(time + s.delay);
+                    int * const w = &b.weight[s.to * LANES];
+
+                    if (b.lanes[s.to] == 0) b.neurons.push_back(s.to);
+
+                    occupied.set(time + s.delay);
+
+                    b.lanes[s.to] |= fired;
+
+                    for (uint32_t l = 0; l < LANES; l++) {
+                        w[l] += sw & -(int) ((fired >> l) & 1);
+                    }
+                }
+            }
+
+            void reset_neurons()
+            {
+                for (size_t i = 0; i < charge.size(); i++) {
+
+                    if (i % LANES == 0) refresh(i / LANES);
+
+                    if (leak[i / LANES]) {
+                        charge[i] = 0;
+                    }
+
+                    if (charge[i] < min_potential) {
+                        charge[i] = min_potential;
+                    }
+                }
+            }
+
+            // A stale bucket still holds the neurons and weights of its old
+            // events, which are cleared here, so the cost of a clear is paid in
+            // proportion to the events it discarded.
+
+            bucket_t & bucket(const uint32_t time)
+            {
+                bucket_t & b = buckets[time & ring_mask];
+
+                if (b.epoch != activity_epoch) {
+                    for (size_t j = 0; j < b.neurons.size(); j++) {
+                        const uint32_t n = b.neurons[j];
+                        b.lanes[n] = 0;
+                        std::fill(&b.weight[n * LANES], &b.weight[(n+1) * LANES], 0);
+                    }
+                    b.neurons.clear();
+                    b.epoch = activity_epoch;
+                }
+
+                return b;
+            }
+
+            void refresh(const uint32_t n)
+            {
+                if (__builtin_expect(tracking_stamp[n] == tracking_epoch, 1)) return;
+
+                if (stamp[n] != activity_epoch) {
+                    std::fill(&charge[n * LANES], &charge[(n+1) * LANES], 0);
+                    stamp[n] = activity_epoch;
+                }
+
+                std::fill(&last_fire[n * LANES], &last_fire[(n+1) * LANES], -1);
+                std::fill(&fire_counts[n * LANES], &fire_counts[(n+1) * LANES], 0);
+                tracking_stamp[n] = tracking_epoch;
+            }
+    };
+}
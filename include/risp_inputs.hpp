@@ -0,0 +1,179 @@
+#pragma once
+
+// Scheduling helpers shared by the RISP engines.  Input spikes may be applied
+// arbitrarily far in the future, but the event rings only cover max_delay
+// timesteps.  Inputs beyond the ring wait in an Input_Queue, a min-heap on
+// absolute time, until their timestep comes up.  A Ring_Occupancy marks the
+// ring's non-empty buckets, so that run() can jump straight to the next
+// timestep with anything to do.
+
+#include <stdint.h>
+
+#include <algorithm>
+#include <vector>
+
+namespace risp
+{
+    template <class Event> class Input_Queue {
+
+        public:
+
+            void push(const uint32_t time, const Event & e)
+            {
+                entry_t x;
+
+                x.time = time;
+                x.event = e;
+
+                heap.push_back(x);
+                std::push_heap(heap.begin(), heap.end(), later);
+            }
+
+            // True if there is an input for timestep time (or earlier).
+
+            bool ready(const uint32_t time) const
+            {
+                return !heap.empty() && heap.front().time <= time;
+            }
+
+            bool empty() const
+            {
+                return heap.empty();
+            }
+
+            // The earliest input's time.  The queue must not be empty.
+
+            uint32_t next_time() const
+            {
+                return heap.front().time;
+            }
+
+            Event pop()
+            {
+                const Event e = heap.front().event;
+
+                std::pop_heap(heap.begin(), heap.end(), later);
+                heap.pop_back();
+
+                return e;
+            }
+
+            void clear()
+            {
+                heap.clear();
+            }
+
+            // The inputs in heap order, for snapshots.  Appending them to an
+            // empty queue in that order rebuilds the same heap, so that they
+            // are popped in the same order.
+
+            size_t size() const
+            {
+                return heap.size();
+            }
+
+            uint32_t time_at(const size_t i) const
+            {
+                return heap[i].time;
+            }
+
+            const Event & event_at(const size_t i) const
+            {
+                return heap[i].event;
+            }
+
+            void append(const uint32_t time, const Event & e)
+            {
+                entry_t x;
+
+                x.time = time;
+                x.event = e;
+
+                heap.push_back(x);
+            }
+
+        private:
+
+            typedef struct {
+
+                uint32_t time;
+                Event event;
+
+            } entry_t;
+
+            std::vector<entry_t> heap;
+
+            static bool later(const entry_t & a, const entry_t & b)
+            {
+                return a.time > b.time;
+            }
+    };
+
+    // One bit per bucket of a ring of size buckets (a power of two).
+
+    class Ring_Occupancy {
+
+        public:
+
+            void resize(const uint32_t size)
+            {
+                mask = size - 1;
+                bits.assign((size + 63) / 64, 0);
+            }
+
+            void set(const uint32_t time)
+            {
+                const uint32_t i = time & mask;
+                bits[i >> 6] |= (uint64_t) 1 << (i & 63);
+            }
+
+            void reset(const uint32_t time)
+            {
+                const uint32_t i = time & mask;
+                bits[i >> 6] &= ~((uint64_t) 1 << (i & 63));
+            }
+
+            void clear()
+            {
+                std::fill(bits.begin(), bits.end(), 0);
+            }
+
+            // The smallest d < count such that the bucket for time + d is
+            // marked, or count if there is none.  Only one ring's worth of
+            // buckets is searched, since every scheduled event is within one
+            // ring of now.
+
+            uint32_t next(const uint32_t time, const uint32_t count) const
+            {
+                const uint32_t limit = std::min(count, mask + 1);
+                uint32_t d = 0;
+
+                while (d < limit) {
+
+                    const uint32_t i = (time + d) & mask;
+                    const uint64_t w = bits[i >> 6] >> (i & 63);
+
+                    if (w != 0) {
+                        d += __builtin_ctzll(w);
+                        return (d < limit) ? d : count;
+                    }
+
+                    d += std::min(64 - (i & 63), mask + 1 - i);
+                }
+
+                return count;
+            }
+
+        private:
+
+            uint32_t mask;
+            std::vector<uint64_t> bits;
+    };
+
+    // Smallest power of two >= n; ring indices are then time & (size-1).
+
+    constexpr uint32_t ring_size(const uint32_t n, const uint32_t r = 1)
+    {
+        return r >= n ? r : ring_size(n, r*2);
+    }
+}
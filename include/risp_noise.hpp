@@ -0,0 +1,108 @@
+#pragma once
+
+// Synaptic noise for the RISP engines (the noisy_stddev, stds and noisy_seed
+// params).  Each time a synapse fires, a normal deviate scaled by the
+// synapse's standard deviation is added to its weight.  The deviate is a
+// pure function of (seed, synapse, time), where synapse is the edge's index
+// in the network file and time is the absolute timestep of the fire, so it
+// does not depend on how many engines, threads or batch lanes there are, or
+// on the order in which they fire synapses.
+//
+// A deviate is one 64-bit hash of the key and a lookup in a table of the
+// normal distribution's quantiles, which is a small fraction of the cost of
+// pushing the event.
+
+#include <stdint.h>
+
+#include <cmath>
+
+namespace risp
+{
+    class Noise {
+
+        public:
+
+            // A standard normal deviate, quantized to QUANTILES levels.
+
+            static double normal(const uint64_t seed, const uint32_t synapse, const uint32_t time)
+            {
+                static const Quantiles q;
+
+                const uint64_t h = mix(seed ^ mix(((uint64_t) synapse << 32) | time));
+
+                return q.z[h >> (64 - QUANTILE_BITS)];
+            }
+
+            // A weight plus scaled noise.  Discrete networks round it to an
+            // integer.
+
+            static double weight(const double weight, const double stddev, const bool discrete,
+                    const uint64_t seed, const uint32_t synapse, const uint32_t time)
+            {
+                const double w = weight + stddev * normal(seed, synapse, time);
+
+                return discrete ? rint(w) : w;
+            }
+
+        private:
+
+            static const int QUANTILE_BITS = 12;
+            static const int QUANTILES = 1 << QUANTILE_BITS;
+
+            // The splitmix64 finalizer.
+
+            static uint64_t mix(uint64_t x)
+            {
+                x += 0x9e3779b97f4a7c15ULL;
+                x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ULL;
+                x = (x ^ (x >> 27)) * 0x94d049bb133111ebULL;
+                return x ^ (x >> 31);
+            }
+
+            // z[i] is the normal quantile at (i + 1/2) / QUANTILES.
+
+            class Quantiles {
+
+                public:
+
+                    Quantiles()
+                    {
+                        for (int i = 0; i < QUANTILES; i++) {
+                            z[i] = inverse_normal((i + 0.5) / QUANTILES);
+                        }
+                    }
+
+                    double z[QUANTILES];
+            };
+
+            // Acklam's rational approximation of the inverse normal CDF,
+            // accurate to about 1e-9 over (0, 1).
+
+            static double inverse_normal(const double p)
+            {
+                static const double a[] = { -3.969683028665376e+01, 2.209460984245205e+02,
+                    -2.759285104469687e+02, 1.383577518672690e+02, -3.066479806614716e+01,
+                    2.506628277459239e+00 };
+                static const double b[] = { -5.447609879822406e+01, 1.615858368580409e+02,
+                    -1.556989798598866e+02, 6.680131188771972e+01, -1.328068155288572e+01 };
+                static const double c[] = { -7.784894002430293e-03, -3.223964580411365e-01,
+                    -2.400758277161838e+00, -2.549732539343734e+00, 4.374664141464968e+00,
+                    2.938163982698783e+00 };
+                static const double d[] = { 7.784695709041462e-03, 3.224671290700398e-01,
+                    2.445134137142996e+00, 3.754408661907416e+00 };
+
+                if (p < 0.02425 || p > 1 - 0.02425) {
+                    const double q = sqrt(-2 * log(p < 0.5 ? p : 1 - p));
+                    const double x = (((((c[0]*q + c[1])*q + c[2])*q + c[3])*q + c[4])*q + c[5]) /
+                        ((((d[0]*q + d[1])*q + d[2])*q + d[3])*q + 1);
+                    return (p < 0.5) ? x : -x;
+                }
+
+                const double q = p - 0.5;
+                const double r = q * q;
+
+                return (((((a[0]*r + a[1])*r + a[2])*r + a[3])*r + a[4])*r + a[5]) * q /
+                    (((((b[0]*r + b[1])*r + b[2])*r + b[3])*r + b[4])*r + 1);
+            }
+    };
+}
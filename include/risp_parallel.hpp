@@ -0,0 +1,601 @@
+#pragma once
+
+// Simulates one large RISP network on several threads.  The neurons of a
+// Runtime_Topology are split into contiguous ranges of dense indices, one
+// partition per thread; since the indices are in locality order, most
+// synapses stay inside a partition.  Each partition owns its neurons' state
+// outright and is the only thread to write it.
+//
+// Every synapse delay is at least one, so a timestep's events all exist
+// before the timestep starts, and the partitions can process it
+// independently.  Events go into mailboxes: partition p appends the events
+// it sends to partition q at timestep t to mail(p, q, t), which only p
+// writes, and which q drains when t comes up.  Two barriers a timestep
+// separate writing from reading: after the first, each thread reads every
+// partition's occupancy to find the next timestep with anything to do;
+// after the second, they all process it.
+//
+// Within a timestep, charges add up in a different order than in
+// Runtime_Network, but they are integers, and noise depends only on (seed,
+// synapse, time), so the results are identical.
+//
+// Outputs are read as in Runtime_Network: output ids, counts and last fires.
+// Output and neuron tracking (fire times, the spike log), charge reports and
+// snapshot(), restore() and clone() are not supported.
+//
+// A timestep costs two barriers, so it only pays off when each partition has
+// many events per timestep.  With one thread it runs at about
+// Runtime_Network's speed (make bench); its speedup on more cores has not
+// been measured in this tree's single-core test environment.
+
+#include <stdint.h>
+#include <stdio.h>
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+#include "risp_inputs.hpp"
+#include "risp_noise.hpp"
+#include "risp_runtime.hpp"
+
+namespace risp
+{
+    class Parallel_Network {
+
+        public:
+
+            // threads == 0 uses one thread per hardware thread.  There are
+            // never more partitions than neurons.
+
+            Parallel_Network(const std::shared_ptr<const Runtime_Topology> & t,
+                    size_t threads = 0)
+                : topology(t),
+                run_end(0),
+                run_generation(0),
+                running(0),
+                stopping(false)
+            {
+                const size_t n = topology->num_neurons();
+
+                if (threads == 0) threads = std::thread::hardware_concurrency();
+                if (threads == 0) threads = 1;
+                if (threads > n) threads = std::max(n, (size_t) 1);
+
+                chunk = (n + threads - 1) / threads;
+                if (chunk == 0) chunk = 1;
+
+                ring = topology->ring_buckets;
+                ring_mask = ring - 1;
+                overall_run_time = 0;
+                run_start = 0;
+                activity_epoch = 0;
+                tracking_epoch = 0;
+
+                charge.assign(n, 0);
+                last_fire.assign(n, -1);
+                fire_counts.assign(n, 0);
+                stamp.assign(n, 0);
+                tracking_stamp.assign(n, 0);
+                check.assign(n, 0);
+
+                partitions.resize(threads);
+
+                for (size_t p = 0; p < threads; p++) {
+                    Partition & part = partitions[p];
+                    part.first = std::min(p * chunk, n);
+                    part.end = std::min((p + 1) * chunk, n);
+                    part.mail.resize(threads * ring);
+                    part.occupied.resize(ring);
+                    part.touched.resize(part.end - part.first);
+                }
+
+                barrier_count = 0;
+                barrier_generation = 0;
+
+                for (size_t p = 1; p < threads; p++) {
+                    workers.push_back(std::thread(&Parallel_Network::work, this, p));
+                }
+            }
+
+            ~Parallel_Network()
+            {
+                {
+                    std::lock_guard<std::mutex> lock(mutex);
+                    stopping = true;
+                }
+
+                wake.notify_all();
+
+                for (size_t i = 0; i < workers.size(); i++) workers[i].join();
+            }
+
+            size_t num_threads() const
+            {
+                return partitions.size();
+            }
+
+            // Spike values are as in risp::Engine::input_weight().
+
+            void apply_spike(const int id, const int time, const double value = 1,
+                    const bool normalized = true)
+            {
+                const uint32_t n = input_index(id);
+                const int weight = input_weight(value, normalized);
+                const size_t q = n / chunk;
+
+                if (time < 0) {
+                    throw std::runtime_error("spike time must be non-negative");
+                }
+
+                event_t e;
+
+                e.neuron = n;
+                e.weight = weight;
+
+                if ((uint32_t) time <= ring_mask) {
+                    partitions[q].mail[mailbox(q, overall_run_time + time)].push_back(e);
+                    partitions[q].occupied.set(overall_run_time + time);
+                }
+                else {
+                    partitions[q].far_inputs.push(overall_run_time + time, e);
+                }
+            }
+
+            void run(int timesteps)
+            {
+                if (overall_run_time != 0) {
+                    tracking_epoch++;
+                }
+
+                if (timesteps <= 0 && !topology->run_time_inclusive) return;
+
+                const size_t run_time = (topology->run_time_inclusive) ? timesteps : timesteps-1;
+
+                run_start = overall_run_time;
+
+                overall_run_time += (run_time+1);
+
+                run_end = overall_run_time;
+
+                {
+                    std::lock_guard<std::mutex> lock(mutex);
+                    running = workers.size();
+                    run_generation++;
+                }
+
+                wake.notify_all();
+
+                simulate(0);
+
+                std::unique_lock<std::mutex> lock(mutex);
+                done.wait(lock, [this] { return running == 0; });
+            }
+
+            // Mailboxes are emptied here rather than by epoch; there are only
+            // threads^2 * ring of them.
+
+            void clear_activity()
+            {
+                activity_epoch++;
+                tracking_epoch++;
+
+                for (size_t p = 0; p < partitions.size(); p++) {
+                    Partition & part = partitions[p];
+                    for (size_t i = 0; i < part.mail.size(); i++) part.mail[i].clear();
+                    part.far_inputs.clear();
+                    part.occupied.clear();
+                }
+
+                overall_run_time = 0;
+            }
+
+            uint32_t get_time() const
+            {
+                return overall_run_time;
+            }
+
+            size_t num_outputs() const
+            {
+                return topology->num_outputs();
+            }
+
+            int output_id(const size_t o) const
+            {
+                return topology->ids[topology->outputs[o]];
+            }
+
+            uint32_t output_count(const size_t o) const
+            {
+                return fire_count(topology->outputs[o]);
+            }
+
+            int output_last_fire(const size_t o) const
+            {
+                const uint32_t n = topology->outputs[o];
+
+                return (tracking_stamp[n] == tracking_epoch) ? last_fire[n] : -1;
+            }
+
+            void output_counts(uint32_t * counts) const
+            {
+                for (size_t o = 0; o < num_outputs(); o++) counts[o] = output_count(o);
+            }
+
+            void output_last_fires(int * times) const
+            {
+                for (size_t o = 0; o < num_outputs(); o++) times[o] = output_last_fire(o);
+            }
+
+            std::vector<uint32_t> output_counts() const
+            {
+                std::vector<uint32_t> v(num_outputs());
+
+                output_counts(v.data());
+
+                return v;
+            }
+
+            std::vector<int> output_last_fires() const
+            {
+                std::vector<int> v(num_outputs());
+
+                output_last_fires(v.data());
+
+                return v;
+            }
+
+            Topology_Checksum topology_checksum() const
+            {
+                return topology->topology_checksum();
+            }
+
+            void report_counts()
+            {
+                const std::vector<uint32_t> & outputs = topology->outputs;
+
+                for (size_t o = 0; o < outputs.size(); o++) {
+                    printf("n%d: %d\n", output_id(o), fire_count(outputs[o]));
+                }
+            }
+
+        private:
+
+            typedef Runtime_Topology::synapse_t synapse_t;
+
+            static const int PALETTE_BITS = Runtime_Topology::PALETTE_BITS;
+            static const int DELAY_BITS = Runtime_Topology::DELAY_BITS;
+
+            typedef struct {
+
+                uint32_t neuron;
+                int weight;
+
+            } event_t;
+
+            // A partition's neurons are [first, end).  mail holds the events
+            // it has sent, by destination partition and timestep (see
+            // mailbox()), and occupied marks the timesteps it has sent any
+            // for.  Inputs beyond the ring wait in far_inputs of the
+            // partition that owns their neuron.
+
+            struct Partition {
+
+                uint32_t first;
+                uint32_t end;
+                std::vector< std::vector<event_t> > mail;
+                Ring_Occupancy occupied;
+                Input_Queue<event_t> far_inputs;
+                std::vector<uint32_t> touched;
+            };
+
+            const std::shared_ptr<const Runtime_Topology> topology;
+
+            size_t chunk;                           // Neurons per partition
+            uint32_t ring;
+            uint32_t ring_mask;
+            std::vector<Partition> partitions;
+
+            std::vector<int> charge;
+            std::vector<int> last_fire;
+            std::vector<uint32_t> fire_counts;
+            std::vector<uint64_t> stamp;            // As in Runtime_Network
+            std::vector<uint64_t> tracking_stamp;
+            std::vector<uint8_t> check;
+
+            uint32_t overall_run_time;
+            uint32_t run_start;
+            uint32_t run_end;
+            uint64_t activity_epoch;
+            uint64_t tracking_epoch;
+
+            // The worker threads run partitions 1 and up; run() runs
+            // partition 0 on the calling thread.
+
+            std::vector<std::thread> workers;
+            std::mutex mutex;
+            std::condition_variable wake;
+            std::condition_variable done;
+            uint64_t run_generation;
+            size_t running;
+            bool stopping;
+
+            std::atomic<size_t> barrier_count;
+            std::atomic<uint64_t> barrier_generation;
+
+            size_t mailbox(const size_t to, const uint32_t time) const
+            {
+                return to * ring + (time & ring_mask);
+            }
+
+            void work(const size_t p)
+            {
+                uint64_t seen = 0;
+
+                while (true) {
+
+                    {
+                        std::unique_lock<std::mutex> lock(mutex);
+                        wake.wait(lock, [this, seen] { return stopping || run_generation != seen; });
+                        if (stopping) return;
+                        seen = run_generation;
+                    }
+
+                    simulate(p);
+
+                    {
+                        std::lock_guard<std::mutex> lock(mutex);
+                        running--;
+                    }
+
+                    done.notify_one();
+                }
+            }
+
+            // Every thread spins here until all have arrived, yielding if the
+            // wait gets long (say, when there are more threads than cores).
+            // A lone thread has nothing to wait for.
+
+            void barrier()
+            {
+                if (partitions.size() == 1) return;
+
+                const uint64_t g = barrier_generation.load(std::memory_order_acquire);
+
+                if (barrier_count.fetch_add(1, std::memory_order_acq_rel) + 1 == partitions.size()) {
+                    barrier_count.store(0, std::memory_order_relaxed);
+                    barrier_generation.fetch_add(1, std::memory_order_release);
+                    return;
+                }
+
+                for (int spins = 0; barrier_generation.load(std::memory_order_acquire) == g; spins++) {
+                    if (spins > 1000) std::this_thread::yield();
+                }
+            }
+
+            // The first timestep from time on (before run_end) that any
+            // partition has events or inputs for, or run_end if none.  Every
+            // thread computes the same answer from the same state.
+
+            uint32_t next_event_time(const uint32_t time) const
+            {
+                uint32_t t = run_end;
+
+                for (size_t p = 0; p < partitions.size(); p++) {
+
+                    const Partition & part = partitions[p];
+
+                    t = std::min(t, time + part.occupied.next(time, run_end - time));
+
+                    if (!part.far_inputs.empty()) {
+                        t = std::min(t, std::max(part.far_inputs.next_time(), time));
+                    }
+                }
+
+                return t;
+            }
+
+            // Partition p's share of run().
+
+            void simulate(const size_t p)
+            {
+                Partition & part = partitions[p];
+
+                uint32_t t = next_event_time(run_start);
+
+                barrier();
+
+                while (t < run_end) {
+
+                    process_events(part, t);
+
+                    barrier();
+
+                    t = next_event_time(t + 1);
+
+                    barrier();
+                }
+
+                reset_neurons(part);
+            }
+
+            // Runtime_Network::process_events() for one partition, whose
+            // events come from every partition's mailbox for it.
+
+            void process_events(Partition & part, const uint32_t time)
+            {
+                const std::vector<uint8_t> & leak = topology->leak;
+                const std::vector<int> & threshold = topology->threshold;
+                const int min_potential = topology->min_potential;
+                const size_t p = &part - &partitions[0];
+
+                size_t touched_count = 0;
+
+                while (part.far_inputs.ready(time)) {
+                    const event_t e = part.far_inputs.pop();
+                    partitions[p].mail[mailbox(p, time)].push_back(e);
+                }
+
+                part.occupied.reset(time);
+
+                for (size_t from = 0; from < partitions.size(); from++) {
+
+                    std::vector<event_t> & es = partitions[from].mail[mailbox(p, time)];
+
+                    for (size_t i = 0; i < es.size(); i++) {
+
+                        const uint32_t n = es[i].neuron;
+
+                        if (!check[n]) {
+
+                            refresh(n);
+
+                            if (leak[n]) {
+                                charge[n] = 0;
+                            }
+                            if (charge[n] < min_potential) {
+                                charge[n] = min_potential;
+                            }
+
+                            check[n] = 1;
+                            part.touched[touched_count++] = n;
+                        }
+
+                        charge[n] += es[i].weight;
+                    }
+
+                    es.clear();
+                }
+
+                for (size_t i = 0; i < touched_count; i++) {
+
+                    const uint32_t n = part.touched[i];
+
+                    check[n] = 0;
+
+                    if (charge[n] >= threshold[n]) {
+
+                        forward_pass_activation(part, n, time);
+
+                        last_fire[n] = time - run_start;
+                        fire_counts[n]++;
+                        charge[n] = 0;
+                    }
+                }
+            }
+
+            void forward_pass_activation(Partition & part, const uint32_t n, const uint32_t time)
+            {
+                const Runtime_Topology & t = *topology;
+
+                for (uint32_t j = t.offsets[n]; j < t.offsets[n+1]; j++) {
+
+                    uint32_t to, delay;
+                    int weight;
+
+                    if (!t.palette.empty()) {
+                        const uint32_t s = t.packed[j];
+                        to = s >> (DELAY_BITS + PALETTE_BITS);
+                        delay = (s >> PALETTE_BITS) & ((1 << DELAY_BITS) - 1);
+                        weight = t.palette[s & ((1 << PALETTE_BITS) - 1)];
+                    }
+                    else {
+                        const synapse_t & s = t.synapses[j];
+                        to = s.to;
+                        delay = s.delay;
+                        weight = s.weight;
+                    }
+
+                    if (t.noisy) {
+                        const double nw = Noise::weight(weight, t.synapse_stddev[j], true,
+                                t.noisy_seed, t.synapse_id[j], time);
+                        weight = (int) std::max(std::min(nw, (double) INT16_MAX), (double) INT16_MIN);
+                    }
+
+                    event_t e;
+
+                    e.neuron = to;
+                    e.weight = weight;
+
+                    part.mail[mailbox(to / chunk, time + delay)].push_back(e);
+                    part.occupied.set(time + delay);
+                }
+            }
+
+            void reset_neurons(Partition & part)
+            {
+                const std::vector<uint8_t> & leak = topology->leak;
+                const int min_potential = topology->min_potential;
+
+                for (uint32_t i = part.first; i < part.end; i++) {
+
+                    refresh(i);
+
+                    if (leak[i]) {
+                        charge[i] = 0;
+                    }
+
+                    if (charge[i] < min_potential) {
+                        charge[i] = min_potential;
+                    }
+                }
+            }
+
+            void refresh(const uint32_t n)
+            {
+                if (__builtin_expect(tracking_stamp[n] == tracking_epoch, 1)) return;
+
+                if (stamp[n] != activity_epoch) {
+                    charge[n] = 0;
+                    stamp[n] = activity_epoch;
+                }
+
+                last_fire[n] = -1;
+                fire_counts[n] = 0;
+                tracking_stamp[n] = tracking_epoch;
+            }
+
+            uint32_t fire_count(const uint32_t n) const
+            {
+                return (tracking_stamp[n] == tracking_epoch) ? fire_counts[n] : 0;
+            }
+
+            uint32_t input_index(const int id) const
+            {
+                const std::vector<uint32_t> & inputs = topology->inputs;
+
+                for (size_t i = 0; i < inputs.size(); i++) {
+                    if (topology->ids[inputs[i]] == id) {
+                        return inputs[i];
+                    }
+                }
+
+                char buf[64];
+                snprintf(buf, sizeof(buf), "%d is not an input neuron", id);
+                throw std::runtime_error(buf);
+            }
+
+            int input_weight(const double value, const bool normalized) const
+            {
+                const std::vector<int> & input_weights = topology->input_weights;
+
+                if (!input_weights.empty()) {
+                    if (value < 0 || value >= input_weights.size() || value != (int) value) {
+                        throw std::runtime_error("spike value is not an index into weights");
+                    }
+                    return input_weights[(int) value];
+                }
+
+                if (normalized && (value < -1 || value > 1)) {
+                    throw std::runtime_error("spike value must be >= -1 and <= 1");
+                }
+
+                return (int) (normalized ? value * topology->spike_value_factor : value);
+            }
+    };
+}
@@ -0,0 +1,238 @@
+#pragma once
+
+// Evaluates a population of RISP networks on a common set of input
+// episodes, spread over a fixed pool of threads.  Every (network, episode)
+// pair is an independent simulation: the network's activity is cleared, the
+// episode's spikes are applied, it runs for the episode's run_time, and its
+// output counts are recorded.
+//
+// Each network's Runtime_Topology is built once and shared by the threads.
+// Each worker thread builds its own risp::Runtime_Network on the topology it
+// is working on, and keeps it for as long as its tasks are on that network,
+// so no simulation state is shared between threads.  Results come back in
+// submission order, whatever order the threads finish in.
+
+#include <stdint.h>
+
+#include <atomic>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "risp_runtime.hpp"
+#include "risp_spec.hpp"
+
+namespace risp
+{
+    // An input spike, with its value as Runtime_Network::apply_spike() takes it.
+
+    typedef struct {
+
+        int id;
+        int time;
+        double value;
+        bool normalized;
+
+    } spike_t;
+
+    class Episode {
+
+        public:
+
+            Episode() : run_time(0) {}
+
+            std::vector<spike_t> spikes;
+            int run_time;
+    };
+
+    class Population_Evaluator {
+
+        public:
+
+            // threads == 0 uses one thread per hardware thread.
+
+            Population_Evaluator(size_t threads = 0)
+                : networks(nullptr),
+                episodes(nullptr),
+                results(nullptr),
+                generation(0),
+                busy(0),
+                stopping(false)
+            {
+                if (threads == 0) threads = std::thread::hardware_concurrency();
+                if (threads == 0) threads = 1;
+
+                for (size_t i = 0; i < threads; i++) {
+                    workers.push_back(std::thread(&Population_Evaluator::work, this));
+                }
+            }
+
+            ~Population_Evaluator()
+            {
+                {
+                    std::lock_guard<std::mutex> lock(mutex);
+                    stopping = true;
+                }
+
+                wake.notify_all();
+
+                for (size_t i = 0; i < workers.size(); i++) workers[i].join();
+            }
+
+            size_t num_threads() const
+            {
+                return workers.size();
+            }
+
+            // Returns one vector of output counts per (network, episode), with
+            // network n's results for episode e at index n * episodes.size() + e.
+            // If any simulation throws, the first error is rethrown here.
+
+            std::vector< std::vector<uint32_t> > evaluate(const std::vector<Network_Spec> & nets,
+                    const std::vector<Episode> & eps)
+            {
+                std::vector< std::vector<uint32_t> > r(nets.size() * eps.size());
+
+                if (r.empty()) return r;
+
+                std::vector< std::shared_ptr<const Runtime_Topology> > topologies;
+
+                for (size_t i = 0; i < nets.size(); i++) {
+                    topologies.push_back(std::make_shared<Runtime_Topology>(nets[i]));
+                }
+
+                std::unique_lock<std::mutex> lock(mutex);
+
+                networks = &topologies;
+                episodes = &eps;
+                results = &r;
+                error = "";
+
+                // Split each network's episodes into enough chunks to keep every
+                // thread busy even when there are fewer networks than threads.
+
+                chunks = (workers.size() + nets.size() - 1) / nets.size();
+                if (chunks > eps.size()) chunks = eps.size();
+                tasks = nets.size() * chunks;
+                next_task = 0;
+
+                busy = workers.size();
+                generation++;
+
+                wake.notify_all();
+                done.wait(lock, [this] { return busy == 0; });
+
+                networks = nullptr;
+                episodes = nullptr;
+                results = nullptr;
+
+                if (error != "") throw std::runtime_error(error);
+
+                return r;
+            }
+
+        private:
+
+            std::vector<std::thread> workers;
+
+            // The current job, set by evaluate() under mutex.
+
+            const std::vector< std::shared_ptr<const Runtime_Topology> > * networks;
+            const std::vector<Episode> * episodes;
+            std::vector< std::vector<uint32_t> > * results;
+            size_t chunks;
+            size_t tasks;
+            std::atomic<size_t> next_task;
+            std::string error;
+
+            std::mutex mutex;
+            std::condition_variable wake;
+            std::condition_variable done;
+            uint64_t generation;
+            size_t busy;
+            bool stopping;
+
+            void work()
+            {
+                uint64_t seen = 0;
+
+                while (true) {
+
+                    {
+                        std::unique_lock<std::mutex> lock(mutex);
+                        wake.wait(lock, [this, seen] { return stopping || generation != seen; });
+                        if (stopping) return;
+                        seen = generation;
+                    }
+
+                    run_tasks();
+
+                    {
+                        std::lock_guard<std::mutex> lock(mutex);
+                        busy--;
+                    }
+
+                    done.notify_one();
+                }
+            }
+
+            // Tasks are handed out network-major, so a thread usually takes
+            // consecutive chunks of the same network and reuses its instance.
+
+            void run_tasks()
+            {
+                Runtime_Network * net = nullptr;
+                size_t net_index = 0;
+
+                for (size_t t = next_task++; t < tasks; t = next_task++) {
+
+                    const size_t n = t / chunks;
+                    const size_t c = t % chunks;
+                    const size_t m = episodes->size();
+
+                    try {
+
+                        if (net == nullptr || net_index != n) {
+                            delete net;
+                            net = nullptr;
+                            net = new Runtime_Network((*networks)[n]);
+                            net_index = n;
+                        }
+
+                        for (size_t e = c * m / chunks; e < (c+1) * m / chunks; e++) {
+                            simulate(*net, (*episodes)[e], (*results)[n * m + e]);
+                        }
+
+                    } catch (const std::exception & ex) {
+                        std::lock_guard<std::mutex> lock(mutex);
+                        if (error == "") error = ex.what();
+                    }
+                }
+
+                delete net;
+            }
+
+            static void simulate(Runtime_Network & net, const Episode & ep,
+                    std::vector<uint32_t> & counts)
+            {
+                net.clear_activity();
+
+                for (size_t i = 0; i < ep.spikes.size(); i++) {
+                    const spike_t & s = ep.spikes[i];
+                    net.apply_spike(s.id, s.time, s.value, s.normalized);
+                }
+
+                net.run(ep.run_time);
+
+                counts.resize(net.num_outputs());
+
+                for (size_t o = 0; o < counts.size(); o++) {
+                    counts[o] = net.output_count(o);
+                }
+            }
+    };
+}
@@ -0,0 +1,962 @@
+#pragma once
+
+// A RISP simulator that reads its network at load time rather than having it
+// compiled in.  It comes in two parts: a Runtime_Topology, which holds
+// everything that the network and params fix and is never written after it
+// is built, and a Runtime_Network, which holds one simulation's state and
+// shares a topology with any number of others (including on other threads).
+//
+// Neuron state lives in flat arrays indexed by a dense neuron index, and
+// each neuron's outgoing synapses are a slice of one compressed-sparse-row
+// table: synapses[offsets[i] .. offsets[i+1]).  The dense indices are
+// Network_Spec::locality_order(), so that neurons that spike into each other
+// sit near each other in the arrays; ids maps them back to node ids, which
+// are all the interface uses.
+// When the params restrict weights to a palette of at most 16 values, the
+// table is packed instead, one 32-bit word per synapse (see packed).
+// Events go on a ring of buckets sized by the network's largest delay, and
+// clearing is by epoch, as in risp::Engine.
+
+#include <stdint.h>
+#include <stdio.h>
+
+#include <algorithm>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "risp_inputs.hpp"
+#include "risp_noise.hpp"
+#include "risp_snapshot.hpp"
+#include "risp_spec.hpp"
+#include "risp_tracking.hpp"
+
+namespace risp
+{
+    class Runtime_Topology {
+
+        friend class Runtime_Network;
+        friend class Parallel_Network;
+
+        public:
+
+            Runtime_Topology(const std::string & network_file,
+                    const std::string & params_file = "")
+            {
+                Network_Spec spec;
+
+                spec.load(network_file, params_file);
+
+                load(spec);
+            }
+
+            // activity, if given, is a per-node profile to order neurons by
+            // (see Network_Spec::locality_order() and
+            // Runtime_Network::node_fire_counts()).
+
+            Runtime_Topology(const Network_Spec & spec,
+                    const std::vector<double> & activity = std::vector<double>())
+            {
+                load(spec, activity);
+            }
+
+            size_t num_neurons() const
+            {
+                return ids.size();
+            }
+
+            size_t num_outputs() const
+            {
+                return outputs.size();
+            }
+
+            // The checksum of the synapse table, by node id.
+
+            Topology_Checksum topology_checksum() const
+            {
+                Topology_Checksum c;
+
+                for (size_t i = 0; i < ids.size(); i++) {
+                    for (uint32_t j = offsets[i]; j < offsets[i+1]; j++) {
+                        if (!palette.empty()) {
+                            const uint32_t s = packed[j];
+                            c.add(ids[i], ids[s >> (DELAY_BITS + PALETTE_BITS)],
+                                    palette[s & ((1 << PALETTE_BITS) - 1)],
+                                    (s >> PALETTE_BITS) & ((1 << DELAY_BITS) - 1));
+                        }
+                        else {
+                            c.add(ids[i], ids[synapses[j].to], synapses[j].weight, synapses[j].delay);
+                        }
+                    }
+                }
+
+                return c;
+            }
+
+            // Topology_Checksum::layout() of the neurons' order; snapshots
+            // restore only between topologies that agree on it.
+
+            uint64_t neuron_layout() const
+            {
+                return layout;
+            }
+
+        private:
+
+            typedef struct {
+
+                uint32_t to;
+                int16_t weight;
+                uint16_t delay;
+
+            } synapse_t;
+
+            std::vector<int> ids;
+            std::vector<int> threshold;     // Made inclusive: charge >= threshold fires
+            std::vector<uint8_t> leak;
+            std::vector<uint32_t> offsets;
+            std::vector<synapse_t> synapses;
+
+            // The packed table: the target neuron in the top TO_BITS, then
+            // the delay, then an index into palette.  Used in place of
+            // synapses when palette isn't empty.
+
+            static const int PALETTE_BITS = 4;
+            static const int DELAY_BITS = 8;
+            static const int TO_BITS = 32 - DELAY_BITS - PALETTE_BITS;
+
+            std::vector<uint32_t> packed;
+            std::vector<int> palette;
+
+            std::vector<uint32_t> synapse_id;       // Index in the network file, and stddev
+            std::vector<float> synapse_stddev;      // of its noise, if noisy
+            std::vector<uint32_t> inputs;
+            std::vector<uint32_t> outputs;
+
+            uint32_t ring_buckets;
+            bool run_time_inclusive;
+            int min_potential;
+            int spike_value_factor;
+            bool noisy;
+            uint64_t noisy_seed;
+            std::vector<int> input_weights; // The weights param, if inputs_from_weights
+            Topology_Checksum checksum;     // Of the synapse table, and
+            uint64_t layout;                // of ids, for snapshots
+
+            static int integer(const double v, const char * what)
+            {
+                if (v != (double) (int) v) {
+                    throw std::runtime_error((std::string) what + " is not an integer");
+                }
+                return (int) v;
+            }
+
+            void load(const Network_Spec & spec,
+                    const std::vector<double> & activity = std::vector<double>())
+            {
+                const Params & p = spec.params;
+
+                if (!p.discrete) {
+                    throw std::runtime_error("Runtime_Network is integer-only (discrete must be true)");
+                }
+
+                run_time_inclusive = p.run_time_inclusive;
+                min_potential = integer(p.min_potential, "min_potential");
+                spike_value_factor = integer(p.spike_value_factor, "spike_value_factor");
+                noisy = p.noisy();
+                noisy_seed = p.noisy_seed;
+
+                const size_t n = spec.nodes.size();
+                const std::vector<uint32_t> nodes = spec.locality_order(activity);
+
+                // index[i] is the dense index of spec.nodes[i].
+
+                std::vector<uint32_t> index(n);
+
+                for (size_t k = 0; k < n; k++) {
+                    const Node_Spec & node = spec.nodes[nodes[k]];
+
+                    index[nodes[k]] = k;
+                    ids.push_back(node.id);
+
+                    // Charges are integers, so charge > t is charge >= t+1.
+
+                    threshold.push_back(integer(node.threshold, "threshold") +
+                            (p.threshold_inclusive ? 0 : 1));
+                    leak.push_back(node.leak);
+                }
+
+                // Counting sort of the edges by source neuron, keeping file order
+                // within a neuron.
+
+                offsets.assign(n+1, 0);
+
+                for (size_t i = 0; i < spec.edges.size(); i++) {
+                    offsets[index[spec.node_index(spec.edges[i].from)] + 1]++;
+                }
+
+                for (size_t i = 0; i < n; i++) {
+                    offsets[i+1] += offsets[i];
+                }
+
+                std::vector<uint32_t> next(offsets.begin(), offsets.end() - 1);
+
+                if (!p.weights.empty() && p.weights.size() <= (1 << PALETTE_BITS) &&
+                        n <= ((size_t) 1 << TO_BITS) && spec.max_edge_delay() < (1 << DELAY_BITS)) {
+                    for (size_t i = 0; i < p.weights.size(); i++) {
+                        palette.push_back(integer(p.weights[i], "weight"));
+                    }
+                    packed.resize(spec.edges.size());
+                }
+                else {
+                    synapses.resize(spec.edges.size());
+                }
+
+                synapse_id.resize(spec.edges.size());
+                synapse_stddev.resize(spec.edges.size());
+
+                for (size_t i = 0; i < spec.edges.size(); i++) {
+
+                    const Edge_Spec & e = spec.edges[i];
+                    const int w = integer(e.weight, "weight");
+
+                    if (w < INT16_MIN || w > INT16_MAX || e.delay > UINT16_MAX) {
+                        throw std::runtime_error("weight or delay too large for Runtime_Network");
+                    }
+
+                    const uint32_t j = next[index[spec.node_index(e.from)]]++;
+
+                    synapse_id[j] = i;
+                    synapse_stddev[j] = e.stddev;
+
+                    if (!palette.empty()) {
+                        packed[j] = index[spec.node_index(e.to)] << (DELAY_BITS + PALETTE_BITS);
+                        packed[j] |= (e.delay << PALETTE_BITS) | e.weight_index;
+                        continue;
+                    }
+
+                    synapse_t & s = synapses[j];
+
+                    s.to = index[spec.node_index(e.to)];
+                    s.weight = w;
+                    s.delay = e.delay;
+                }
+
+                for (size_t i = 0; i < spec.inputs.size(); i++) {
+                    inputs.push_back(index[spec.node_index(spec.inputs[i])]);
+                }
+
+                if (p.inputs_from_weights) {
+                    for (size_t i = 0; i < p.weights.size(); i++) {
+                        input_weights.push_back(integer(p.weights[i], "weight"));
+                    }
+                }
+
+                for (size_t i = 0; i < spec.outputs.size(); i++) {
+                    outputs.push_back(index[spec.node_index(spec.outputs[i])]);
+                }
+
+                ring_buckets = ring_size(spec.max_edge_delay() + 1);
+                checksum = topology_checksum();
+                layout = Topology_Checksum::layout(ids.data(), ids.size());
+            }
+    };
+
+    class Runtime_Network {
+
+        public:
+
+            Runtime_Network(const std::string & network_file,
+                    const std::string & params_file = "")
+                : topology(std::make_shared<Runtime_Topology>(network_file, params_file))
+            {
+                allocate();
+            }
+
+            Runtime_Network(const Network_Spec & spec,
+                    const std::vector<double> & activity = std::vector<double>())
+                : topology(std::make_shared<Runtime_Topology>(spec, activity))
+            {
+                allocate();
+            }
+
+            // A new simulation of a topology that other instances may share.
+            // Only the state is allocated.
+
+            Runtime_Network(const std::shared_ptr<const Runtime_Topology> & t)
+                : topology(t)
+            {
+                allocate();
+            }
+
+            const std::shared_ptr<const Runtime_Topology> & get_topology() const
+            {
+                return topology;
+            }
+
+            // Spike values are as in risp::Engine::input_weight().
+
+            void apply_spike(const int id, const int time, const double value = 1,
+                    const bool normalized = true)
+            {
+                const int n = input_index(id);
+                const int weight = input_weight(value, normalized);
+
+                if (time < 0) {
+                    throw std::runtime_error("spike time must be non-negative");
+                }
+
+                if ((uint32_t) time <= ring_mask) {
+                    push_event(overall_run_time + time, n, weight);
+                }
+                else {
+                    event_t e;
+                    e.neuron = n;
+                    e.weight = weight;
+                    far_inputs.push(overall_run_time + time, e);
+                }
+            }
+
+            void run(int timesteps)
+            {
+                if (overall_run_time != 0) {
+                    tracking_epoch++;
+                }
+
+                spike_log.clear();
+
+                if (timesteps <= 0 && !topology->run_time_inclusive) return;
+
+                const size_t run_time = (topology->run_time_inclusive) ? timesteps : timesteps-1;
+
+                run_start = overall_run_time;
+
+                overall_run_time += (run_time+1);
+
+                // Only timesteps with events (or inputs due) are processed.
+
+                for (uint32_t t = next_event_time(run_start); t < overall_run_time;
+                        t = next_event_time(t + 1)) {
+                    process_events(t);
+                }
+
+                reset_neurons();
+            }
+
+            void clear_activity()
+            {
+                activity_epoch++;
+                tracking_epoch++;
+
+                far_inputs.clear();
+                occupied.clear();
+                spike_log.clear();
+
+                overall_run_time = 0;
+            }
+
+            uint32_t get_time() const
+            {
+                return overall_run_time;
+            }
+
+            size_t num_outputs() const
+            {
+                return topology->num_outputs();
+            }
+
+            int output_id(const size_t o) const
+            {
+                return topology->ids[topology->outputs[o]];
+            }
+
+            // Outputs are read as in risp::Engine.
+
+            uint32_t output_count(const size_t o) const
+            {
+                return fire_count(topology->outputs[o]);
+            }
+
+            int output_last_fire(const size_t o) const
+            {
+                const uint32_t n = topology->outputs[o];
+
+                return (tracking_stamp[n] == tracking_epoch) ? last_fire[n] : -1;
+            }
+
+            void output_counts(uint32_t * counts) const
+            {
+                for (size_t o = 0; o < num_outputs(); o++) counts[o] = output_count(o);
+            }
+
+            void output_last_fires(int * times) const
+            {
+                for (size_t o = 0; o < num_outputs(); o++) times[o] = output_last_fire(o);
+            }
+
+            std::vector<uint32_t> output_counts() const
+            {
+                std::vector<uint32_t> v(num_outputs());
+
+                output_counts(v.data());
+
+                return v;
+            }
+
+            std::vector<int> output_last_fires() const
+            {
+                std::vector<int> v(num_outputs());
+
+                output_last_fires(v.data());
+
+                return v;
+            }
+
+            bool track_output_events(const size_t o, const bool track = true)
+            {
+                if (o >= num_outputs()) throw std::runtime_error("bad output index");
+
+                if (output_log.empty()) output_log.resize(charge.size(), topology->outputs);
+
+                logged[topology->outputs[o]] = track;
+
+                return true;
+            }
+
+            std::vector<int> output_vector(const size_t o) const
+            {
+                const uint32_t n = topology->outputs[o];
+
+                if (!logged[n]) return std::vector<int>();
+
+                return output_log.fire_times(n, tracking_epoch);
+            }
+
+            std::vector< std::vector<int> > output_vectors() const
+            {
+                std::vector< std::vector<int> > v;
+
+                for (size_t o = 0; o < num_outputs(); o++) v.push_back(output_vector(o));
+
+                return v;
+            }
+
+            Topology_Checksum topology_checksum() const
+            {
+                return topology->topology_checksum();
+            }
+
+            // Neuron tracking is as in risp::Engine.
+
+            // The node ids, sorted, which index neuron_vectors().
+
+            std::vector<int> node_ids() const
+            {
+                std::vector<int> v;
+
+                for (size_t i = 0; i < topology->num_neurons(); i++) v.push_back(topology->ids[i]);
+
+                std::sort(v.begin(), v.end());
+
+                return v;
+            }
+
+            bool track_neuron_events(const int id, const bool track = true)
+            {
+                if (spike_log.get_capacity() == 0) spike_log.resize(Spike_Log::DEFAULT_CAPACITY);
+
+                traced[neuron_index(id)] = track;
+
+                return true;
+            }
+
+            void set_spike_log_capacity(const size_t entries)
+            {
+                spike_log.resize(entries);
+            }
+
+            std::vector< std::vector<int> > neuron_vectors() const
+            {
+                const std::vector<int> ids = node_ids();
+                std::vector< std::vector<int> > v(ids.size());
+
+                for (size_t i = 0; i < spike_log.entries(); i++) {
+                    const int id = topology->ids[spike_log.neuron_at(i)];
+                    v[std::lower_bound(ids.begin(), ids.end(), id) - ids.begin()].push_back(
+                            spike_log.time_at(i));
+                }
+
+                return v;
+            }
+
+            size_t drain_spikes(int * ids, int * times, const size_t max)
+            {
+                const size_t n = spike_log.drain((uint32_t *) ids, times, max);
+
+                for (size_t i = 0; i < n; i++) ids[i] = topology->ids[(uint32_t) ids[i]];
+
+                return n;
+            }
+
+            size_t spikes_dropped() const
+            {
+                return spike_log.dropped_count();
+            }
+
+            // Each node's fire count since tracking was last cleared, in
+            // Network_Spec node order.  Summed over representative runs, this
+            // is an activity profile for the constructor.
+
+            std::vector<double> node_fire_counts() const
+            {
+                const std::vector<int> & ids = topology->ids;
+                std::vector< std::pair<int, uint32_t> > c;
+
+                for (size_t i = 0; i < ids.size(); i++) {
+                    c.push_back(std::make_pair(ids[i], fire_count(i)));
+                }
+
+                std::sort(c.begin(), c.end());
+
+                std::vector<double> counts;
+
+                for (size_t i = 0; i < c.size(); i++) counts.push_back(c[i].second);
+
+                return counts;
+            }
+
+            // Snapshots are as in risp::Engine::snapshot(), in the format of
+            // risp_snapshot.hpp.  A snapshot restores into any instance of a
+            // topology built the same way from the same network, including
+            // the same activity profile; restore() throws otherwise.  As
+            // there, tracking is not part of the snapshot.
+
+            std::vector<uint8_t> snapshot() const
+            {
+                Snapshot_Writer w(topology->checksum, topology->layout, charge.size(), false);
+
+                w.put<uint32_t>(overall_run_time);
+                w.put<uint32_t>(run_start);
+
+                for (size_t i = 0; i < charge.size(); i++) {
+
+                    const bool tracked = (tracking_stamp[i] == tracking_epoch);
+
+                    w.put<int32_t>((tracked || stamp[i] == activity_epoch) ? charge[i] : 0);
+                    w.put<int32_t>(tracked ? last_fire[i] : -1);
+                    w.put<uint32_t>(fire_count(i));
+                }
+
+                uint32_t count = 0;
+
+                for (uint32_t k = 0; k <= ring_mask; k++) {
+                    const uint32_t b = (overall_run_time + k) & ring_mask;
+                    if (event_stamp[b] == activity_epoch) count += events[b].size();
+                }
+
+                w.put<uint32_t>(count);
+
+                for (uint32_t k = 0; k <= ring_mask; k++) {
+
+                    const uint32_t b = (overall_run_time + k) & ring_mask;
+
+                    if (event_stamp[b] != activity_epoch) continue;
+
+                    for (size_t i = 0; i < events[b].size(); i++) {
+                        put_event(w, k, events[b][i]);
+                    }
+                }
+
+                w.put<uint32_t>(far_inputs.size());
+
+                for (size_t i = 0; i < far_inputs.size(); i++) {
+                    put_event(w, far_inputs.time_at(i) - overall_run_time, far_inputs.event_at(i));
+                }
+
+                return w.bytes;
+            }
+
+            void restore(const std::vector<uint8_t> & s)
+            {
+                Snapshot_Reader r(s, topology->checksum, topology->layout, charge.size(), false);
+
+                clear_activity();
+
+                try {
+                    overall_run_time = r.get<uint32_t>();
+                    run_start = r.get<uint32_t>();
+
+                    for (size_t i = 0; i < charge.size(); i++) {
+                        charge[i] = r.get<int32_t>();
+                        last_fire[i] = r.get<int32_t>();
+                        fire_counts[i] = r.get<uint32_t>();
+                        stamp[i] = activity_epoch;
+                        tracking_stamp[i] = tracking_epoch;
+                    }
+
+                    for (uint32_t i = r.get<uint32_t>(); i > 0; i--) {
+
+                        uint32_t offset;
+                        const event_t e = get_event(r, offset);
+
+                        if (offset > ring_mask) throw std::runtime_error("snapshot is corrupt");
+
+                        push_event(overall_run_time + offset, e.neuron, e.weight);
+                    }
+
+                    for (uint32_t i = r.get<uint32_t>(); i > 0; i--) {
+
+                        uint32_t offset;
+                        const event_t e = get_event(r, offset);
+
+                        far_inputs.append(overall_run_time + offset, e);
+                    }
+
+                    r.finish();
+                }
+                catch (...) {
+                    clear_activity();
+                    throw;
+                }
+            }
+
+            // A new instance of the topology in this one's state, tracking
+            // the same outputs and neurons, as in risp::Engine::clone().
+
+            Runtime_Network * clone() const
+            {
+                Runtime_Network * n = new Runtime_Network(topology);
+
+                n->restore(snapshot());
+
+                if (!output_log.empty()) n->output_log.resize(charge.size(), topology->outputs);
+                if (spike_log.get_capacity() != 0) n->set_spike_log_capacity(spike_log.get_capacity());
+
+                n->logged = logged;
+                n->traced = traced;
+
+                return n;
+            }
+
+            void report_counts()
+            {
+                const std::vector<uint32_t> & outputs = topology->outputs;
+
+                for (size_t o = 0; o < outputs.size(); o++) {
+                    printf("n%d: %d\n", topology->ids[outputs[o]], fire_count(outputs[o]));
+                }
+            }
+
+        private:
+
+            typedef Runtime_Topology::synapse_t synapse_t;
+
+            static const int PALETTE_BITS = Runtime_Topology::PALETTE_BITS;
+            static const int DELAY_BITS = Runtime_Topology::DELAY_BITS;
+
+            typedef struct {
+
+                uint32_t neuron;
+                int weight;
+
+            } event_t;
+
+            const std::shared_ptr<const Runtime_Topology> topology;
+
+            std::vector<int> charge;
+            std::vector<int> last_fire;
+            std::vector<uint32_t> fire_counts;
+            std::vector<uint64_t> stamp;            // activity_epoch when charge was written
+            std::vector<uint64_t> tracking_stamp;   // tracking_epoch when fire state was
+            std::vector<uint8_t> check;
+            std::vector<uint8_t> logged;            // Tracked outputs
+            std::vector<uint8_t> traced;            // Tracked neurons
+            std::vector<uint32_t> touched;
+            std::vector< std::vector<event_t> > events;
+            std::vector<uint64_t> event_stamp;
+            uint32_t ring_mask;
+            Input_Queue<event_t> far_inputs;
+            Ring_Occupancy occupied;
+            Output_Log output_log;
+            Spike_Log spike_log;
+
+            uint32_t overall_run_time;
+            uint32_t run_start;
+            uint64_t activity_epoch;
+            uint64_t tracking_epoch;
+
+            void allocate()
+            {
+                const size_t n = topology->num_neurons();
+
+                overall_run_time = 0;
+                run_start = 0;
+                activity_epoch = 0;
+                tracking_epoch = 0;
+
+                events.resize(topology->ring_buckets);
+                ring_mask = events.size() - 1;
+                event_stamp.assign(events.size(), 0);
+                occupied.resize(events.size());
+
+                charge.assign(n, 0);
+                last_fire.assign(n, -1);
+                fire_counts.assign(n, 0);
+                stamp.assign(n, 0);
+                tracking_stamp.assign(n, 0);
+                check.assign(n, 0);
+                logged.assign(n, 0);
+                traced.assign(n, 0);
+                touched.assign(n, 0);
+            }
+
+            static void put_event(Snapshot_Writer & w, const uint32_t offset, const event_t & e)
+            {
+                w.put<uint32_t>(offset);
+                w.put<uint32_t>(e.neuron);
+                w.put<int32_t>(e.weight);
+            }
+
+            event_t get_event(Snapshot_Reader & r, uint32_t & offset) const
+            {
+                event_t e;
+
+                offset = r.get<uint32_t>();
+                e.neuron = r.get<uint32_t>();
+                e.weight = r.get<int32_t>();
+
+                if (e.neuron >= charge.size()) throw std::runtime_error("snapshot is corrupt");
+
+                return e;
+            }
+
+            uint32_t neuron_index(const int id) const
+            {
+                const std::vector<int> & ids = topology->ids;
+
+                for (size_t i = 0; i < ids.size(); i++) {
+                    if (ids[i] == id) return i;
+                }
+
+                char buf[64];
+                snprintf(buf, sizeof(buf), "%d is not a neuron", id);
+                throw std::runtime_error(buf);
+            }
+
+            int input_index(const int id) const
+            {
+                const std::vector<uint32_t> & inputs = topology->inputs;
+
+                for (size_t i = 0; i < inputs.size(); i++) {
+                    if (topology->ids[inputs[i]] == id) {
+                        return inputs[i];
+                    }
+                }
+
+                char buf[64];
+                snprintf(buf, sizeof(buf), "%d is not an input neuron", id);
+                throw std::runtime_error(buf);
+            }
+
+            int input_weight(const double value, const bool normalized) const
+            {
+                const std::vector<int> & input_weights = topology->input_weights;
+
+                if (!input_weights.empty()) {
+                    if (value < 0 || value >= input_weights.size() || value != (int) value) {
+                        throw std::runtime_error("spike value is not an index into weights");
+                    }
+                    return input_weights[(int) value];
+                }
+
+                if (normalized && (value < -1 || value > 1)) {
+                    throw std::runtime_error("spike value must be >= -1 and <= 1");
+                }
+
+                return (int) (normalized ? value * topology->spike_value_factor : value);
+            }
+
+            void push_event(const uint32_t time, const uint32_t neuron, const int weight)
+            {
+                event_t e;
+
+                e.neuron = neuron;
+                e.weight = weight;
+
+                bucket(time).push_back(e);
+                occupied.set(time);
+            }
+
+            // The first timestep from time on (before overall_run_time) with a
+            // non-empty bucket or a far input due, or overall_run_time if none.
+
+            uint32_t next_event_time(const uint32_t time) const
+            {
+                uint32_t t = time + occupied.next(time, overall_run_time - time);
+
+                if (!far_inputs.empty() && far_inputs.next_time() < t) {
+                    t = std::max(far_inputs.next_time(), time);
+                }
+
+                return t;
+            }
+
+            // Same fused kernel as risp::Engine::process_events().
+
+            void process_events(const uint32_t time)
+            {
+                while (far_inputs.ready(time)) {
+                    const event_t e = far_inputs.pop();
+                    push_event(time, e.neuron, e.weight);
+                }
+
+                const std::vector<uint8_t> & leak = topology->leak;
+                const std::vector<int> & threshold = topology->threshold;
+                const int min_potential = topology->min_potential;
+
+                std::vector<event_t> & es = bucket(time);
+
+                size_t touched_count = 0;
+
+                for (size_t i = 0; i < es.size(); i++) {
+
+                    const uint32_t n = es[i].neuron;
+
+                    if (!check[n]) {
+
+                        refresh(n);
+
+                        if (leak[n]) {
+                            charge[n] = 0;
+                        }
+                        if (charge[n] < min_potential) {
+                            charge[n] = min_potential;
+                        }
+
+                        check[n] = 1;
+                        touched[touched_count++] = n;
+                    }
+
+                    charge[n] += es[i].weight;
+                }
+
+                es.clear();
+                occupied.reset(time);
+
+                for (size_t i = 0; i < touched_count; i++) {
+
+                    const uint32_t n = touched[i];
+
+                    check[n] = 0;
+
+                    if (charge[n] >= threshold[n]) {
+
+                        forward_pass_activation(n, time);
+
+                        last_fire[n] = time - run_start;
+                        fire_counts[n]++;
+                        charge[n] = 0;
+
+                        if (__builtin_expect(logged[n], 0)) {
+                            output_log.record(n, time - run_start, tracking_epoch);
+                        }
+
+                        spike_log.append(n, time - run_start, traced[n]);
+                    }
+                }
+            }
+
+            void forward_pass_activation(const uint32_t n, const uint32_t time)
+            {
+                const Runtime_Topology & t = *topology;
+
+                if (!t.palette.empty()) {
+
+                    for (uint32_t j = t.offsets[n]; j < t.offsets[n+1]; j++) {
+
+                        const uint32_t s = t.packed[j];
+
+                        push_event(time + ((s >> PALETTE_BITS) & ((1 << DELAY_BITS) - 1)),
+                                s >> (DELAY_BITS + PALETTE_BITS),
+                                synapse_weight(j, t.palette[s & ((1 << PALETTE_BITS) - 1)], time));
+                    }
+
+                    return;
+                }
+
+                for (uint32_t j = t.offsets[n]; j < t.offsets[n+1]; j++) {
+                    const synapse_t & s = t.synapses[j];
+                    push_event(time + s.delay, s.to, synapse_weight(j, s.weight, time));
+                }
+            }
+
+            // Synapse j's weight w when it fires at time: with noise, if noisy
+            // (see risp_noise.hpp).
+
+            int synapse_weight(const uint32_t j, const int w, const uint32_t time) const
+            {
+                const Runtime_Topology & t = *topology;
+
+                if (!t.noisy) return w;
+
+                const double nw = Noise::weight(w, t.synapse_stddev[j], true,
+                        t.noisy_seed, t.synapse_id[j], time);
+
+                return (int) std::max(std::min(nw, (double) INT16_MAX), (double) INT16_MIN);
+            }
+
+            void reset_neurons()
+            {
+                const std::vector<uint8_t> & leak = topology->leak;
+                const int min_potential = topology->min_potential;
+
+                for (size_t i = 0; i < charge.size(); i++) {
+
+                    refresh(i);
+
+                    if (leak[i]) {
+                        charge[i] = 0;
+                    }
+
+                    if (charge[i] < min_potential) {
+                        charge[i] = min_potential;
+                    }
+                }
+            }
+
+            // Buckets and neuron state written before the last clear are
+            // cleared on first use; see risp::Engine.
+
+            std::vector<event_t> & bucket(const uint32_t time)
+            {
+                const uint32_t b = time & ring_mask;
+
+                if (event_stamp[b] != activity_epoch) {
+                    events[b].clear();
+                    event_stamp[b] = activity_epoch;
+                }
+
+                return events[b];
+            }
+
+            void refresh(const uint32_t n)
+            {
+                if (__builtin_expect(tracking_stamp[n] == tracking_epoch, 1)) return;
+
+                if (stamp[n] != activity_epoch) {
+                    charge[n] = 0;
+                    stamp[n] = activity_epoch;
+                }
+
+                last_fire[n] = -1;
+                fire_counts[n] = 0;
+                tracking_stamp[n] = tracking_epoch;
+            }
+
+            uint32_t fire_count(const uint32_t n) const
+            {
+                return (tracking_stamp[n] == tracking_epoch) ? fire_counts[n] : 0;
+            }
+    };
+}
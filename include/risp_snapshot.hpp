@@ -0,0 +1,131 @@
+#pragma once
+
+// The binary snapshot format of risp::Engine::snapshot() and
+// risp::Runtime_Network::snapshot(): a simulation's complete state, which
+// restore() puts back so that the simulation continues exactly as it would
+// have.  All fields are in native byte order:
+//
+//   "RSNP", version                               uint32 each
+//   topology checksum: edges, sum                 uint64 each
+//   neuron layout                                 uint64
+//   neurons, float charges (0 or 1)               uint32 each
+//   overall_run_time, run_start                   uint32 each
+//   per neuron: charge, last_fire, fire count     charge, int32, uint32
+//   bucket events: count, then per event
+//       timestep - overall_run_time, neuron, weight    uint32, uint32, charge
+//   far inputs: count, then the same per input
+//
+// Charges and weights are int32, or float32 if the engine's charges are
+// floats.  Neurons and events use the engine's dense neuron indices, so a
+// snapshot restores only into a network built from the same network file
+// with the same neuron layout.  The checksum guards against another network,
+// and the layout (Topology_Checksum::layout()) against the same network laid
+// out in another order, e.g. by a Runtime_Topology built with an activity
+// profile.
+// Bucket events are in timestep order and then the order they were
+// scheduled in, and far inputs are in Input_Queue's heap order, so that
+// events are processed in the same order after a restore.
+
+#include <stdint.h>
+#include <string.h>
+
+#include <stdexcept>
+#include <vector>
+
+#include "risp_topology.hpp"
+
+namespace risp
+{
+    class Snapshot_Writer {
+
+        public:
+
+            Snapshot_Writer(const Topology_Checksum & c, const uint64_t layout,
+                    const uint32_t neurons, const bool float_charges)
+            {
+                put<uint32_t>(MAGIC);
+                put<uint32_t>(VERSION);
+                put<uint64_t>(c.edges);
+                put<uint64_t>(c.sum);
+                put<uint64_t>(layout);
+                put<uint32_t>(neurons);
+                put<uint32_t>(float_charges);
+            }
+
+            template <class V> void put(const V v)
+            {
+                const size_t n = bytes.size();
+
+                bytes.resize(n + sizeof(V));
+                memcpy(&bytes[n], &v, sizeof(V));
+            }
+
+            std::vector<uint8_t> bytes;
+
+            static const uint32_t MAGIC = 0x504e5352;   // "RSNP"
+            static const uint32_t VERSION = 2;
+    };
+
+    class Snapshot_Reader {
+
+        public:
+
+            // Throws unless the snapshot is of a network with this checksum,
+            // layout, number of neurons and charge type.
+
+            Snapshot_Reader(const std::vector<uint8_t> & b, const Topology_Checksum & c,
+                    const uint64_t layout, const uint32_t neurons, const bool float_charges)
+                : bytes(b), pos(0)
+            {
+                if (get<uint32_t>() != Snapshot_Writer::MAGIC) {
+                    throw std::runtime_error("not a RISP snapshot");
+                }
+                if (get<uint32_t>() != Snapshot_Writer::VERSION) {
+                    throw std::runtime_error("unsupported RISP snapshot version");
+                }
+
+                Topology_Checksum s;
+
+                s.edges = get<uint64_t>();
+                s.sum = get<uint64_t>();
+
+                const uint64_t l = get<uint64_t>();
+
+                if (!(s == c) || get<uint32_t>() != neurons) {
+                    throw std::runtime_error("snapshot is of a different network");
+                }
+                if (l != layout) {
+                    throw std::runtime_error("snapshot has a different neuron layout");
+                }
+                if (get<uint32_t>() != (uint32_t) float_charges) {
+                    throw std::runtime_error("snapshot has a different charge type");
+                }
+            }
+
+            template <class V> V get()
+            {
+                V v;
+
+                if (bytes.size() - pos < sizeof(V)) {
+                    throw std::runtime_error("snapshot is truncated");
+                }
+
+                memcpy(&v, &bytes[pos], sizeof(V));
+                pos += sizeof(V);
+
+                return v;
+            }
+
+            // Throws unless the whole snapshot has been read.
+
+            void finish() const
+            {
+                if (pos != bytes.size()) throw std::runtime_error("snapshot has trailing data");
+            }
+
+        private:
+
+            const std::vector<uint8_t> & bytes;
+            size_t pos;
+    };
+}
@@ -0,0 +1,459 @@
+#pragma once
+
+// Reading RISP processor parameters and network JSON into plain structures
+// that the header generator and the simulators build themselves from.  VRISP
+// networks use the same format, and VRISP's parameters are a subset of RISP's
+// plus tracked_timesteps.
+
+#include <stdint.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "risp_topology.hpp"
+#include "utils/json.hpp"
+
+namespace risp
+{
+    class Params {
+
+        public:
+
+            Params()
+                : min_weight(-1),
+                max_weight(1),
+                min_threshold(-1),
+                max_threshold(1),
+                min_potential(-1),
+                max_delay(5),
+                discrete(false),
+                leak_mode("none"),
+                run_time_inclusive(false),
+                threshold_inclusive(true),
+                fire_like_ravens(false),
+                spike_value_factor(1),
+                inputs_from_weights(false),
+                noisy_seed(0),
+                noisy_stddev(0),
+                tracked_timesteps(0) {}
+
+            void from_json(const neuro::Json & j)
+            {
+                if (j.contains("weights")) {
+                    weights.clear();
+                    for (size_t i = 0; i < j["weights"].size(); i++) {
+                        weights.push_back(j["weights"][i].as_double());
+                    }
+                    min_weight = *std::min_element(weights.begin(), weights.end());
+                    max_weight = *std::max_element(weights.begin(), weights.end());
+                }
+
+                if (j.contains("min_weight")) min_weight = j["min_weight"].as_double();
+                if (j.contains("max_weight")) max_weight = j["max_weight"].as_double();
+                if (j.contains("min_threshold")) min_threshold = j["min_threshold"].as_double();
+                if (j.contains("max_threshold")) max_threshold = j["max_threshold"].as_double();
+                if (j.contains("min_potential")) min_potential = j["min_potential"].as_double();
+                if (j.contains("max_delay")) max_delay = j["max_delay"].as_int();
+                if (j.contains("discrete")) discrete = j["discrete"].as_bool();
+                if (j.contains("leak_mode")) leak_mode = j["leak_mode"].as_string();
+                if (j.contains("run_time_inclusive")) {
+                    run_time_inclusive = j["run_time_inclusive"].as_bool();
+                }
+                if (j.contains("threshold_inclusive")) {
+                    threshold_inclusive = j["threshold_inclusive"].as_bool();
+                }
+                if (j.contains("fire_like_ravens")) {
+                    fire_like_ravens = j["fire_like_ravens"].as_bool();
+                }
+                if (j.contains("inputs_from_weights")) {
+                    inputs_from_weights = j["inputs_from_weights"].as_bool();
+                }
+
+                if (j.contains("noisy_seed")) noisy_seed = j["noisy_seed"].as_int();
+                if (j.contains("noisy_stddev")) noisy_stddev = j["noisy_stddev"].as_double();
+
+                if (j.contains("stds")) {
+                    stds.clear();
+                    for (size_t i = 0; i < j["stds"].size(); i++) {
+                        stds.push_back(j["stds"][i].as_double());
+                    }
+                }
+
+                if (j.contains("tracked_timesteps")) {
+                    tracked_timesteps = j["tracked_timesteps"].as_int();
+                }
+
+                spike_value_factor = j.contains("spike_value_factor") ?
+                    j["spike_value_factor"].as_double() : max_weight;
+
+                if (leak_mode != "none" && leak_mode != "all" && leak_mode != "configurable") {
+                    throw std::runtime_error("Bad leak_mode \"" + leak_mode + "\"");
+                }
+
+                if (inputs_from_weights && weights.empty()) {
+                    throw std::runtime_error("inputs_from_weights requires weights");
+                }
+
+                // No engine delays fires by a timestep, so networks that need
+                // it are refused rather than run with the wrong timing.
+
+                if (fire_like_ravens) {
+                    throw std::runtime_error("fire_like_ravens is not supported");
+                }
+
+                if (max_delay < 1) {
+                    throw std::runtime_error("max_delay must be at least one");
+                }
+
+                if (!stds.empty() && stds.size() != weights.size()) {
+                    throw std::runtime_error("stds must have one entry per weight");
+                }
+
+                // The seed is fixed here, so that every engine built from these
+                // params draws the same noise.
+
+                if (noisy() && noisy_seed == 0) {
+                    noisy_seed = (uint32_t) std::chrono::duration_cast<std::chrono::microseconds>(
+                            std::chrono::system_clock::now().time_since_epoch()).count();
+                    if (noisy_seed == 0) noisy_seed = 1;
+                }
+            }
+
+            bool noisy() const
+            {
+                return noisy_stddev != 0 || !stds.empty();
+            }
+
+            double min_weight;
+            double max_weight;
+            double min_threshold;
+            double max_threshold;
+            double min_potential;
+            int max_delay;
+            bool discrete;
+            std::string leak_mode;
+            bool run_time_inclusive;
+            bool threshold_inclusive;
+            bool fire_like_ravens;
+            double spike_value_factor;
+            std::vector<double> weights;
+            bool inputs_from_weights;
+            int64_t noisy_seed;
+            double noisy_stddev;
+            std::vector<double> stds;
+            int tracked_timesteps;      // VRISP only; 0 means max_delay+1
+    };
+
+    class Node_Spec {
+
+        public:
+
+            int id;
+            std::string name;
+            double threshold;
+            bool leak;
+    };
+
+    class Edge_Spec {
+
+        public:
+
+            int from;
+            int to;
+            double weight;
+            int delay;
+            double stddev;      // Of the synapse's noise; see risp_noise.hpp
+            int weight_index;   // Into the weights param, or -1 if there is none
+    };
+
+    class Network_Spec {
+
+        public:
+
+            // Reads a network JSON file.  If params_file is empty, the processor
+            // parameters come from the network's Associated_Data.proc_params.
+
+            void load(const std::string & network_file, const std::string & params_file = "")
+            {
+                const neuro::Json j = neuro::Json::read_file(network_file);
+
+                if (params_file != "") {
+                    params.from_json(neuro::Json::read_file(params_file));
+                }
+                else if (j.contains("Associated_Data") &&
+                        j["Associated_Data"].contains("proc_params")) {
+                    params.from_json(j["Associated_Data"]["proc_params"]);
+                }
+                else {
+                    throw std::runtime_error(network_file +
+                            " has no proc_params, and no params file was given");
+                }
+
+                from_json(j);
+            }
+
+            void from_json(const neuro::Json & j)
+            {
+                const neuro::Json & props = j["Properties"];
+
+                const int threshold_index = property_index(props["node_properties"], "Threshold");
+                const int leak_index = property_index(props["node_properties"], "Leak");
+                const int weight_index = property_index(props["edge_properties"], "Weight");
+                const int delay_index = property_index(props["edge_properties"], "Delay");
+
+                if (threshold_index < 0 || weight_index < 0 || delay_index < 0) {
+                    throw std::runtime_error("Network is missing Threshold, Weight or Delay");
+                }
+
+                nodes.clear();
+                edges.clear();
+                inputs.clear();
+                outputs.clear();
+
+                const neuro::Json & jn = j["Nodes"];
+
+                for (size_t i = 0; i < jn.size(); i++) {
+
+                    Node_Spec n;
+
+                    n.id = jn[i]["id"].as_int();
+                    n.name = jn[i].contains("name") ? jn[i]["name"].as_string() : "";
+                    n.threshold = jn[i]["values"][threshold_index].as_double();
+                    n.leak = (params.leak_mode == "all") ||
+                        (params.leak_mode == "configurable" && leak_index >= 0 &&
+                         jn[i]["values"][leak_index].as_double() != 0);
+
+                    nodes.push_back(n);
+                }
+
+                std::sort(nodes.begin(), nodes.end(), node_less);
+
+                for (size_t i = 1; i < nodes.size(); i++) {
+                    if (nodes[i].id == nodes[i-1].id) {
+                        throw std::runtime_error("Duplicate node id in network");
+                    }
+                }
+
+                const neuro::Json & je = j["Edges"];
+
+                for (size_t i = 0; i < je.size(); i++) {
+
+                    Edge_Spec e;
+
+                    e.from = je[i]["from"].as_int();
+                    e.to = je[i]["to"].as_int();
+                    e.weight = je[i]["values"][weight_index].as_double();
+
+                    // With a weights param, the Weight property is an index into it.
+
+                    e.stddev = params.noisy_stddev;
+                    e.weight_index = -1;
+
+                    if (!params.weights.empty()) {
+                        if (e.weight < 0 || e.weight >= params.weights.size() ||
+                                e.weight != rint(e.weight)) {
+                            throw std::runtime_error("Edge weight is not an index into weights");
+                        }
+                        e.weight_index = (int) e.weight;
+                        if (!params.stds.empty()) e.stddev = params.stds[(size_t) e.weight];
+                        e.weight = params.weights[(size_t) e.weight];
+                    }
+                    e.delay = (int) rint(je[i]["values"][delay_index].as_double());
+
+                    if (node_index(e.from) < 0 || node_index(e.to) < 0) {
+                        throw std::runtime_error("Edge refers to a nonexistent node");
+                    }
+
+                    if (e.delay < 1 || e.delay > params.max_delay) {
+                        throw std::runtime_error("Edge delay is out of range");
+                    }
+
+                    edges.push_back(e);
+                }
+
+                for (size_t i = 0; i < j["Inputs"].size(); i++) {
+                    inputs.push_back(j["Inputs"][i].as_int());
+                }
+
+                for (size_t i = 0; i < j["Outputs"].size(); i++) {
+                    outputs.push_back(j["Outputs"][i].as_int());
+                }
+
+                for (size_t i = 0; i < inputs.size(); i++) {
+                    if (node_index(inputs[i]) < 0) {
+                        throw std::runtime_error("Input refers to a nonexistent node");
+                    }
+                }
+
+                for (size_t i = 0; i < outputs.size(); i++) {
+                    if (node_index(outputs[i]) < 0) {
+                        throw std::runtime_error("Output refers to a nonexistent node");
+                    }
+                }
+            }
+
+            // Index of the node in the (id-sorted) nodes vector, or -1.
+
+            int node_index(const int id) const
+            {
+                size_t lo = 0;
+                size_t hi = nodes.size();
+
+                while (lo < hi) {
+                    const size_t mid = (lo + hi) / 2;
+                    if (nodes[mid].id < id) lo = mid + 1; else hi = mid;
+                }
+
+                return (lo < nodes.size() && nodes[lo].id == id) ? (int) lo : -1;
+            }
+
+            // A renumbering of the nodes for locality: order[k] is the index
+            // (into nodes) of the node to place k'th.  This is reverse
+            // Cuthill-McKee on the synapse graph with directions ignored, with
+            // the breadth-first search started from the inputs, so that
+            // neurons that exchange spikes end up near each other.  Neighbors
+            // are visited in increasing order of degree or, if activity (per
+            // node, e.g. fire counts from a profiling run) is given, in
+            // decreasing order of activity.
+
+            std::vector<uint32_t> locality_order(
+                    const std::vector<double> & activity = std::vector<double>()) const
+            {
+                const size_t n = nodes.size();
+                std::vector< std::vector<uint32_t> > adj(n);
+
+                if (!activity.empty() && activity.size() != n) {
+                    throw std::runtime_error("activity must have one entry per node");
+                }
+
+                for (size_t i = 0; i < edges.size(); i++) {
+                    const uint32_t f = node_index(edges[i].from);
+                    const uint32_t t = node_index(edges[i].to);
+                    if (f == t) continue;
+                    adj[f].push_back(t);
+                    adj[t].push_back(f);
+                }
+
+                // Neighbors in visiting order, and then start nodes: the inputs,
+                // then any node not reachable from them, lowest degree first.
+
+                const Visit_Less less(adj, activity);
+                std::vector<uint32_t> starts;
+
+                for (size_t i = 0; i < n; i++) std::sort(adj[i].begin(), adj[i].end(), less);
+
+                for (size_t i = 0; i < inputs.size(); i++) {
+                    starts.push_back(node_index(inputs[i]));
+                }
+
+                const size_t ninputs = starts.size();
+
+                for (size_t i = 0; i < n; i++) starts.push_back(i);
+
+                std::sort(starts.begin() + ninputs, starts.end(), Visit_Less(adj));
+
+                std::vector<uint32_t> order;
+                std::vector<bool> placed(n, false);
+
+                order.reserve(n);
+
+                for (size_t s = 0; s < starts.size(); s++) {
+
+                    if (placed[starts[s]]) continue;
+
+                    placed[starts[s]] = true;
+                    order.push_back(starts[s]);
+
+                    for (size_t head = order.size() - 1; head < order.size(); head++) {
+                        const std::vector<uint32_t> & a = adj[order[head]];
+                        for (size_t j = 0; j < a.size(); j++) {
+                            if (!placed[a[j]]) {
+                                placed[a[j]] = true;
+                                order.push_back(a[j]);
+                            }
+                        }
+                    }
+                }
+
+                std::reverse(order.begin(), order.end());
+
+                return order;
+            }
+
+            Topology_Checksum topology_checksum() const
+            {
+                Topology_Checksum c;
+
+                for (size_t i = 0; i < edges.size(); i++) {
+                    c.add(edges[i].from, edges[i].to, edges[i].weight, edges[i].delay);
+                }
+
+                return c;
+            }
+
+            int max_edge_delay() const
+            {
+                int d = 1;
+
+                for (size_t i = 0; i < edges.size(); i++) {
+                    d = std::max(d, edges[i].delay);
+                }
+
+                return d;
+            }
+
+            Params params;
+            std::vector<Node_Spec> nodes;
+            std::vector<Edge_Spec> edges;
+            std::vector<int> inputs;
+            std::vector<int> outputs;
+
+        private:
+
+            // Orders nodes by decreasing activity if there is any, and otherwise
+            // by increasing degree, breaking ties by index.
+
+            class Visit_Less {
+
+                public:
+
+                    Visit_Less(const std::vector< std::vector<uint32_t> > & a,
+                            const std::vector<double> & act = std::vector<double>())
+                        : adj(a), activity(act) {}
+
+                    bool operator()(const uint32_t x, const uint32_t y) const
+                    {
+                        if (!activity.empty() && activity[x] != activity[y]) {
+                            return activity[x] > activity[y];
+                        }
+                        if (adj[x].size() != adj[y].size()) return adj[x].size() < adj[y].size();
+                        return x < y;
+                    }
+
+                private:
+
+                    const std::vector< std::vector<uint32_t> > & adj;
+                    const std::vector<double> activity;
+            };
+
+            static bool node_less(const Node_Spec & a, const Node_Spec & b)
+            {
+                return a.id < b.id;
+            }
+
+            static int property_index(const neuro::Json & props, const std::string & name)
+            {
+                for (size_t i = 0; i < props.size(); i++) {
+                    if (props[i]["name"].as_string() == name) {
+                        return props[i]["index"].as_int();
+                    }
+                }
+
+                return -1;
+            }
+    };
+}
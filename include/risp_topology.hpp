@@ -0,0 +1,66 @@
+#pragma once
+
+// An order-independent checksum of a network's synapses, so that the edge
+// tables an engine builds can be checked against the network file they came
+// from (processor_tool's TC command, and scripts/test_topology.sh).  Each
+// synapse is hashed from its endpoints' node ids, its weight (as a float,
+// which every engine's weights convert to exactly) and its delay, and the
+// hashes are summed.
+//
+// layout() is the opposite: a hash of the node id at each dense neuron index,
+// in order, so that two engines agree on it only if they lay the network's
+// neurons out the same way.  Snapshots, which are by neuron index, carry it.
+
+#include <stdint.h>
+#include <string.h>
+
+namespace risp
+{
+    class Topology_Checksum {
+
+        public:
+
+            Topology_Checksum() : edges(0), sum(0) {}
+
+            void add(const int from, const int to, const double weight, const int delay)
+            {
+                const float w = (float) weight;
+                uint32_t wbits;
+
+                memcpy(&wbits, &w, sizeof(wbits));
+
+                sum += mix(mix(((uint64_t) (uint32_t) from << 32) | (uint32_t) to) ^
+                        (((uint64_t) wbits << 32) | (uint32_t) delay));
+                edges++;
+            }
+
+            bool operator==(const Topology_Checksum & c) const
+            {
+                return edges == c.edges && sum == c.sum;
+            }
+
+            static uint64_t layout(const int * ids, const size_t n)
+            {
+                uint64_t h = n;
+
+                for (size_t i = 0; i < n; i++) h = mix(h ^ (uint32_t) ids[i]);
+
+                return h;
+            }
+
+            uint64_t edges;
+            uint64_t sum;
+
+        private:
+
+            // The splitmix64 finalizer, as in risp_noise.hpp.
+
+            static uint64_t mix(uint64_t x)
+            {
+                x += 0x9e3779b97f4a7c15ULL;
+                x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ULL;
+                x = (x ^ (x >> 27)) * 0x94d049bb133111ebULL;
+                return x ^ (x >> 31);
+            }
+    };
+}
@@ -0,0 +1,185 @@
+#pragma once
+
+// Event tracking shared by the RISP engines.  An Output_Log records the fire
+// times of tracked output neurons in the current run, for output_vector(),
+// and a Spike_Log those of tracked neurons, for neuron_vectors() (see
+// markdown/processor.md).  Their storage is allocated when tracking is first
+// turned on, never during a run.
+
+#include <stdint.h>
+
+#include <vector>
+
+namespace risp
+{
+    // Each output has a ring of LOG_SIZE fire times.  A run that fires an
+    // output more often than that keeps only its last LOG_SIZE fires.  Fires
+    // are stamped with the engine's tracking epoch, so a new run (or a
+    // clear_activity()) empties every log without touching it.
+
+    class Output_Log {
+
+        public:
+
+            static const uint32_t LOG_SIZE = 1024;
+
+            bool empty() const
+            {
+                return slot.empty();
+            }
+
+            // outputs[o] is output o's neuron index.
+
+            void resize(const size_t neurons, const std::vector<uint32_t> & outputs)
+            {
+                slot.assign(neurons, 0);
+
+                for (size_t o = outputs.size(); o > 0; o--) slot[outputs[o-1]] = o-1;
+
+                times.assign(outputs.size() * LOG_SIZE, 0);
+                fires.assign(outputs.size(), 0);
+                stamp.assign(outputs.size(), 0);
+            }
+
+            // A fire of neuron n, which must be an output.
+
+            void record(const uint32_t n, const int time, const uint64_t epoch)
+            {
+                const uint32_t o = slot[n];
+
+                if (stamp[o] != epoch) {
+                    fires[o] = 0;
+                    stamp[o] = epoch;
+                }
+
+                times[o * LOG_SIZE + (fires[o] & (LOG_SIZE - 1))] = time;
+                fires[o]++;
+            }
+
+            // Output neuron n's fire times in the run stamped epoch, oldest
+            // first.
+
+            std::vector<int> fire_times(const uint32_t n, const uint64_t epoch) const
+            {
+                std::vector<int> v;
+
+                if (empty()) return v;
+
+                const uint32_t o = slot[n];
+
+                if (stamp[o] != epoch) return v;
+
+                const uint32_t kept = (fires[o] < LOG_SIZE) ? fires[o] : LOG_SIZE;
+
+                for (uint32_t i = fires[o] - kept; i < fires[o]; i++) {
+                    v.push_back(times[o * LOG_SIZE + (i & (LOG_SIZE - 1))]);
+                }
+
+                return v;
+            }
+
+        private:
+
+            std::vector<uint32_t> slot;     // Output index, by neuron index
+            std::vector<int> times;
+            std::vector<uint32_t> fires;
+            std::vector<uint64_t> stamp;
+    };
+
+    // The current run's fires of tracked neurons, as two columns: neuron
+    // index and timestep.  Every fire is appended, without a branch: each
+    // writes the next free entry, and only a tracked one claims it.  So there
+    // is always one more entry than the capacity, and once the log is full,
+    // further tracked fires are counted as dropped rather than recorded.
+
+    class Spike_Log {
+
+        public:
+
+            static const size_t DEFAULT_CAPACITY = 1 << 16;
+
+            Spike_Log() : neuron(1), times(1), capacity(0)
+            {
+                clear();
+            }
+
+            size_t get_capacity() const
+            {
+                return capacity;
+            }
+
+            // Discards the log's contents.
+
+            void resize(const size_t entries)
+            {
+                neuron.assign(entries + 1, 0);
+                times.assign(entries + 1, 0);
+                capacity = entries;
+                clear();
+            }
+
+            void clear()
+            {
+                size = 0;
+                head = 0;
+                dropped = 0;
+            }
+
+            void append(const uint32_t n, const int time, const bool track)
+            {
+                const size_t claimed = track & (size < capacity);
+
+                neuron[size] = n;
+                times[size] = time;
+
+                size += claimed;
+                dropped += track - claimed;
+            }
+
+            size_t entries() const
+            {
+                return size;
+            }
+
+            uint32_t neuron_at(const size_t i) const
+            {
+                return neuron[i];
+            }
+
+            int time_at(const size_t i) const
+            {
+                return times[i];
+            }
+
+            size_t dropped_count() const
+            {
+                return dropped;
+            }
+
+            // Copies up to max of the entries not yet drained, oldest first,
+            // and returns how many.
+
+            size_t drain(uint32_t * ns, int * ts, const size_t max)
+            {
+                const size_t n = (size - head < max) ? size - head : max;
+
+                for (size_t i = 0; i < n; i++) {
+                    ns[i] = neuron[head + i];
+                    ts[i] = times[head + i];
+                }
+
+                head += n;
+
+                return n;
+            }
+
+        private:
+
+            std::vector<uint32_t> neuron;
+            std::vector<int> times;
+            size_t capacity;
+            size_t size;
+            size_t head;
+            size_t dropped;
+    };
+}
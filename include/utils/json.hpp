@@ -0,0 +1,479 @@
+#pragma once
+
+// A small, dependency-free JSON reader and writer.  It understands exactly
+// what the network and processor-parameter files in this repo need: objects,
+// arrays, strings, numbers, booleans and null.
+
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <map>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace neuro
+{
+    class Json {
+
+        public:
+
+            enum Type { Null, Boolean, Number, String, Array, Object };
+
+            Json() : type(Null), boolean(false), number(0) {}
+
+            static Json make(const Type t)
+            {
+                Json j;
+                j.type = t;
+                return j;
+            }
+
+            static Json make_number(const double v)
+            {
+                Json j = make(Number);
+                j.number = v;
+                return j;
+            }
+
+            static Json make_string(const std::string & v)
+            {
+                Json j = make(String);
+                j.str = v;
+                return j;
+            }
+
+            static Json make_bool(const bool v)
+            {
+                Json j = make(Boolean);
+                j.boolean = v;
+                return j;
+            }
+
+            static Json parse(const std::string & text)
+            {
+                size_t pos = 0;
+
+                Json j = parse_value(text, pos);
+
+                skip_space(text, pos);
+
+                if (pos != text.size()) {
+                    fail("trailing characters", pos);
+                }
+
+                return j;
+            }
+
+            static Json read_file(const std::string & filename)
+            {
+                std::ifstream f(filename.c_str());
+
+                if (!f) {
+                    throw std::runtime_error("Couldn't open " + filename);
+                }
+
+                std::stringstream ss;
+                ss << f.rdbuf();
+
+                return parse(ss.str());
+            }
+
+            bool contains(const std::string & key) const
+            {
+                return type == Object && object.find(key) != object.end();
+            }
+
+            const Json & operator[](const std::string & key) const
+            {
+                std::map<std::string, Json>::const_iterator it;
+
+                if (type != Object || (it = object.find(key)) == object.end()) {
+                    throw std::runtime_error("JSON is missing key \"" + key + "\"");
+                }
+
+                return it->second;
+            }
+
+            // Inserts key (as null) if it isn't there.  The value must be an object.
+
+            Json & operator[](const std::string & key)
+            {
+                expect(Object, "object");
+                return object[key];
+            }
+
+            void push_back(const Json & j)
+            {
+                expect(Array, "array");
+                array.push_back(j);
+            }
+
+            const Json & operator[](const size_t i) const
+            {
+                if (type != Array || i >= array.size()) {
+                    throw std::runtime_error("JSON array index out of range");
+                }
+
+                return array[i];
+            }
+
+            size_t size() const
+            {
+                return type == Array ? array.size() : type == Object ? object.size() : 0;
+            }
+
+            double as_double() const
+            {
+                if (type == Boolean) return boolean ? 1 : 0;
+                expect(Number, "number");
+                return number;
+            }
+
+            int as_int() const
+            {
+                return (int) as_double();
+            }
+
+            bool as_bool() const
+            {
+                expect(Boolean, "boolean");
+                return boolean;
+            }
+
+            const std::string & as_string() const
+            {
+                expect(String, "string");
+                return str;
+            }
+
+            // Compact, single-line JSON.  Object keys come out sorted.
+
+            std::string dump() const
+            {
+                std::string s;
+                dump(s);
+                return s;
+            }
+
+            void write_file(const std::string & filename) const
+            {
+                std::ofstream f(filename.c_str());
+
+                if (!f) {
+                    throw std::runtime_error("Couldn't open " + filename);
+                }
+
+                f << dump() << std::endl;
+            }
+
+            Type type;
+            bool boolean;
+            double number;
+            std::string str;
+            std::vector<Json> array;
+            std::map<std::string, Json> object;
+
+        private:
+
+            void dump(std::string & s) const
+            {
+                std::map<std::string, Json>::const_iterator it;
+
+                switch (type) {
+
+                    case Null:
+                        s += "null";
+                        break;
+
+                    case Boolean:
+                        s += boolean ? "true" : "false";
+                        break;
+
+                    case Number:
+                        s += number_string(number);
+                        break;
+
+                    case String:
+                        dump_string(s, str);
+                        break;
+
+                    case Array:
+                        s += '[';
+                        for (size_t i = 0; i < array.size(); i++) {
+                            if (i > 0) s += ',';
+                            array[i].dump(s);
+                        }
+                        s += ']';
+                        break;
+
+                    case Object:
+                        s += '{';
+                        for (it = object.begin(); it != object.end(); it++) {
+                            if (it != object.begin()) s += ',';
+                            dump_string(s, it->first);
+                            s += ':';
+                            it->second.dump(s);
+                        }
+                        s += '}';
+                        break;
+                }
+            }
+
+            // Integers print without a fraction; anything else with the fewest
+            // digits that read back to the same double.
+
+            static std::string number_string(const double v)
+            {
+                char buf[32];
+
+                if (v == (double) (long long) v) {
+                    snprintf(buf, sizeof(buf), "%lld", (long long) v);
+                    return buf;
+                }
+
+                snprintf(buf, sizeof(buf), "%.15g", v);
+
+                if (strtod(buf, NULL) != v) {
+                    snprintf(buf, sizeof(buf), "%.17g", v);
+                }
+
+                return buf;
+            }
+
+            static void dump_string(std::string & s, const std::string & v)
+            {
+                s += '"';
+
+                for (size_t i = 0; i < v.size(); i++) {
+
+                    switch (v[i]) {
+                        case '"': s += "\\\""; break;
+                        case '\\': s += "\\\\"; break;
+                        case '\n': s += "\\n"; break;
+                        case '\t': s += "\\t"; break;
+                        case '\r': s += "\\r"; break;
+                        default:
+                            if ((unsigned char) v[i] < 0x20) {
+                                char buf[8];
+                                snprintf(buf, sizeof(buf), "\\u%04x", (unsigned char) v[i]);
+                                s += buf;
+                            }
+                            else {
+                                s += v[i];
+                            }
+                            break;
+                    }
+                }
+
+                s += '"';
+            }
+
+            void expect(const Type t, const char * what) const
+            {
+                if (type != t) {
+                    throw std::runtime_error((std::string) "JSON value is not a " + what);
+                }
+            }
+
+            static void fail(const char * what, const size_t pos)
+            {
+                std::ostringstream ss;
+                ss << "JSON parse error at offset " << pos << ": " << what;
+                throw std::runtime_error(ss.str());
+            }
+
+            static void skip_space(const std::string & s, size_t & pos)
+            {
+                while (pos < s.size() && (s[pos] == ' ' || s[pos] == '\t' ||
+                            s[pos] == '\n' || s[pos] == '\r')) {
+                    pos++;
+                }
+            }
+
+            static void expect_word(const std::string & s, size_t & pos, const char * word)
+            {
+                const std::string w = word;
+
+                if (s.compare(pos, w.size(), w) != 0) {
+                    fail("bad literal", pos);
+                }
+
+                pos += w.size();
+            }
+
+            static std::string parse_string(const std::string & s, size_t & pos)
+            {
+                std::string rv;
+
+                pos++;   // opening quote
+
+                while (pos < s.size() && s[pos] != '"') {
+
+                    if (s[pos] == '\\') {
+
+                        pos++;
+
+                        if (pos >= s.size()) break;
+
+                        switch (s[pos]) {
+                            case 'n': rv += '\n'; break;
+                            case 't': rv += '\t'; break;
+                            case 'r': rv += '\r'; break;
+                            case 'b': rv += '\b'; break;
+                            case 'f': rv += '\f'; break;
+                            case 'u':
+                                      // Names in our networks are ASCII; keep the
+                                      // low byte of \uXXXX escapes.
+                                      if (pos + 4 >= s.size()) fail("bad \\u escape", pos);
+                                      rv += (char) strtol(s.substr(pos+1, 4).c_str(), NULL, 16);
+                                      pos += 4;
+                                      break;
+                            default: rv += s[pos]; break;
+                        }
+                    }
+                    else {
+                        rv += s[pos];
+                    }
+
+                    pos++;
+                }
+
+                if (pos >= s.size()) {
+                    fail("unterminated string", pos);
+                }
+
+                pos++;   // closing quote
+
+                return rv;
+            }
+
+            static Json parse_value(const std::string & s, size_t & pos)
+            {
+                Json j;
+
+                skip_space(s, pos);
+
+                if (pos >= s.size()) {
+                    fail("unexpected end of input", pos);
+                }
+
+                const char c = s[pos];
+
+                if (c == '{') {
+
+                    j.type = Object;
+                    pos++;
+                    skip_space(s, pos);
+
+                    if (pos < s.size() && s[pos] == '}') {
+                        pos++;
+                        return j;
+                    }
+
+                    while (true) {
+
+                        skip_space(s, pos);
+
+                        if (pos >= s.size() || s[pos] != '"') {
+                            fail("expected a key", pos);
+                        }
+
+                        const std::string key = parse_string(s, pos);
+
+                        skip_space(s, pos);
+
+                        if (pos >= s.size() || s[pos] != ':') {
+                            fail("expected ':'", pos);
+                        }
+
+                        pos++;
+
+                        j.object[key] = parse_value(s, pos);
+
+                        skip_space(s, pos);
+
+                        if (pos < s.size() && s[pos] == ',') {
+                            pos++;
+                        }
+                        else if (pos < s.size() && s[pos] == '}') {
+                            pos++;
+                            return j;
+                        }
+                        else {
+                            fail("expected ',' or '}'", pos);
+                        }
+                    }
+                }
+
+                if (c == '[') {
+
+                    j.type = Array;
+                    pos++;
+                    skip_space(s, pos);
+
+                    if (pos < s.size() && s[pos] == ']') {
+                        pos++;
+                        return j;
+                    }
+
+                    while (true) {
+
+                        j.array.push_back(parse_value(s, pos));
+
+                        skip_space(s, pos);
+
+                        if (pos < s.size() && s[pos] == ',') {
+                            pos++;
+                        }
+                        else if (pos < s.size() && s[pos] == ']') {
+                            pos++;
+                            return j;
+                        }
+                        else {
+                            fail("expected ',' or ']'", pos);
+                        }
+                    }
+                }
+
+                if (c == '"') {
+                    j.type = String;
+                    j.str = parse_string(s, pos);
+                    return j;
+                }
+
+                if (c == 't') {
+                    expect_word(s, pos, "true");
+                    j.type = Boolean;
+                    j.boolean = true;
+                    return j;
+                }
+
+                if (c == 'f') {
+                    expect_word(s, pos, "false");
+                    j.type = Boolean;
+                    return j;
+                }
+
+                if (c == 'n') {
+                    expect_word(s, pos, "null");
+                    return j;
+                }
+
+                const char * start = s.c_str() + pos;
+                char * end;
+
+                j.number = strtod(start, &end);
+
+                if (end == start) {
+                    fail("unexpected character", pos);
+                }
+
+                j.type = Number;
+                pos += end - start;
+
+                return j;
+            }
+    };
+}
@@ -0,0 +1,513 @@
+#pragma once
+
+// VRISP, the vectorizable variant of RISP (see markdown/vrisp.md).  State is
+// kept as a structure of arrays: per-neuron thresholds, leak and fired
+// bitmasks (64 neurons to a word), and a [tracked_timesteps][neurons] matrix
+// of charges that doubles as the event queue -- a synapse firing with delay d
+// adds its weight to row (now + d) % tracked_timesteps.  Every neuron is
+// evaluated every timestep, so each phase of a step is a straight loop over
+// contiguous arrays.
+//
+// The per-step phases run on the kernels in vrisp_kernels.hpp, chosen at
+// load time from what the CPU supports; set_kernel() overrides the choice.
+//
+// Differences from RISP: values are integers, a threshold of 0 fires every
+// timestep, run times are exclusive and thresholds inclusive.  Charges are as
+// wide as the narrowest of 8, 16 and 32 bits that holds the params' weights,
+// thresholds, min_potential and spike_value_factor, and wrap when they
+// overflow it.  Charges are raised to min_potential at the end of each
+// timestep, so a spike applied between runs at time 0 adds to the raised
+// charge and may take it below min_potential.
+
+#include <stdint.h>
+#include <stdio.h>
+
+#include <algorithm>
+#include <climits>
+#include <cmath>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "risp_spec.hpp"
+#include "vrisp_kernels.hpp"
+
+namespace vrisp
+{
+    class Network {
+
+        public:
+
+            Network(const std::string & network_file, const std::string & params_file = "")
+            {
+                risp::Network_Spec spec;
+
+                spec.load(network_file, params_file);
+
+                load(spec);
+            }
+
+            Network(const risp::Network_Spec & spec)
+            {
+                load(spec);
+            }
+
+            // VRISP parameters must be integers, and tracked_timesteps (if given)
+            // must cover max_delay.
+
+            static void check_params(const risp::Params & p)
+            {
+                integer(p.min_weight, "min_weight");
+                integer(p.max_weight, "max_weight");
+                integer(p.min_threshold, "min_threshold");
+                integer(p.max_threshold, "max_threshold");
+                integer(p.min_potential, "min_potential");
+
+                if (p.tracked_timesteps != 0 && p.tracked_timesteps <= p.max_delay) {
+                    throw std::runtime_error("tracked_timesteps must be greater than max_delay");
+                }
+            }
+
+            // An empty network whose properties match proc_params, for
+            // network_tool to build on.
+
+            static neuro::Json empty_network(const neuro::Json & proc_params)
+            {
+                risp::Params p;
+
+                p.from_json(proc_params);
+                check_params(p);
+
+                neuro::Json props = neuro::Json::make(neuro::Json::Object);
+                neuro::Json nprops = neuro::Json::make(neuro::Json::Array);
+                neuro::Json eprops = neuro::Json::make(neuro::Json::Array);
+
+                nprops.push_back(property("Threshold", 'I', 0, p.min_threshold, p.max_threshold));
+
+                if (p.leak_mode == "configurable") {
+                    nprops.push_back(property("Leak", 'B', 1, 0, 1));
+                }
+
+                eprops.push_back(property("Delay", 'I', 1, 1, p.max_delay));
+                eprops.push_back(property("Weight", 'I', 0, p.min_weight, p.max_weight));
+
+                props["node_properties"] = nprops;
+                props["edge_properties"] = eprops;
+                props["network_properties"] = neuro::Json::make(neuro::Json::Array);
+
+                neuro::Json other = neuro::Json::make(neuro::Json::Object);
+                other["proc_name"] = neuro::Json::make_string("vrisp");
+
+                neuro::Json data = neuro::Json::make(neuro::Json::Object);
+                data["other"] = other;
+                data["proc_params"] = proc_params;
+
+                neuro::Json net = neuro::Json::make(neuro::Json::Object);
+                net["Properties"] = props;
+                net["Nodes"] = neuro::Json::make(neuro::Json::Array);
+                net["Edges"] = neuro::Json::make(neuro::Json::Array);
+                net["Inputs"] = neuro::Json::make(neuro::Json::Array);
+                net["Outputs"] = neuro::Json::make(neuro::Json::Array);
+                net["Network_Values"] = neuro::Json::make(neuro::Json::Array);
+                net["Associated_Data"] = data;
+
+                return net;
+            }
+
+            // time is relative to the current timestep, and must be less than
+            // tracked_timesteps.  Normalized values are in [-1,1] and are scaled
+            // by spike_value_factor.
+
+            void apply_spike(const int id, const int time, const double value = 1,
+                    const bool normalized = true)
+            {
+                const uint32_t n = input_index(id);
+
+                if (time < 0) {
+                    throw std::runtime_error("spike time must be non-negative");
+                }
+
+                if ((uint32_t) time >= tracked) {
+                    char buf[100];
+                    snprintf(buf, sizeof(buf), "spike time %d is beyond tracked_timesteps (%u)",
+                            time, tracked);
+                    throw std::runtime_error(buf);
+                }
+
+                if (normalized && (value < -1 || value > 1)) {
+                    throw std::runtime_error("spike value must be >= -1 and <= 1");
+                }
+
+                const int v = normalized ? value * spike_value_factor : value;
+
+                row_of(row + time)[n] += v;
+            }
+
+            void run(const int timesteps)
+            {
+                clear_tracking_info();
+
+                run_start = overall_run_time;
+
+                // Each step raises the charges that the previous step left
+                // behind, so the last step's are raised here, before any more
+                // inputs are applied.
+
+                for (int i = 0; i < timesteps; i++) {
+                    step(run_start + i, (i == 0) ? INT_MIN : min_potential);
+                }
+
+                if (timesteps > 0) {
+                    int * const c = row_of(row);
+
+                    for (size_t i = 0; i < stride; i++) {
+                        c[i] = std::max(narrow(c[i], shift), min_potential);
+                    }
+
+                    overall_run_time += timesteps;
+                }
+            }
+
+            void clear_activity()
+            {
+                std::fill(charges.begin(), charges.end(), 0);
+                clear_tracking_info();
+
+                row = 0;
+                overall_run_time = 0;
+            }
+
+            uint32_t get_time() const
+            {
+                return overall_run_time;
+            }
+
+            void set_kernel(const Kernel k)
+            {
+                if (!kernel_supported(k)) {
+                    throw std::runtime_error((std::string) "The " + kernel_name(k) +
+                            " kernel is not supported on this CPU");
+                }
+                kernel = k;
+            }
+
+            Kernel get_kernel() const
+            {
+                return kernel;
+            }
+
+            uint32_t output_count(const size_t o) const
+            {
+                return fire_counts[outputs[o]];
+            }
+
+            int output_last_fire(const size_t o) const
+            {
+                return last_fire[outputs[o]];
+            }
+
+            size_t num_outputs() const
+            {
+                return outputs.size();
+            }
+
+            void report_counts()
+            {
+                for (size_t o = 0; o < outputs.size(); o++) {
+                    printf("node %s spike counts: %u\n", names[outputs[o]].c_str(),
+                            fire_counts[outputs[o]]);
+                }
+            }
+
+            void report_last_fires()
+            {
+                for (size_t o = 0; o < outputs.size(); o++) {
+                    printf("node %s last fire time: %.1f\n", names[outputs[o]].c_str(),
+                            (double) last_fire[outputs[o]]);
+                }
+            }
+
+            // Charges going into the next timestep, for the given node ids (or
+            // all nodes), with names right-justified as processor_tool does.
+
+            void report_charges(const std::vector<int> & node_ids)
+            {
+                size_t width = 0;
+
+                for (size_t i = 0; i < names.size(); i++) {
+                    width = std::max(width, names[i].size());
+                }
+
+                for (size_t i = 0; i < neuron_count; i++) {
+                    if (node_ids.empty() ||
+                            std::find(node_ids.begin(), node_ids.end(), ids[i]) != node_ids.end()) {
+                        printf("Node %*s charge: %d\n", (int) width, names[i].c_str(),
+                                narrow(row_of(row)[i], shift));
+                    }
+                }
+            }
+
+        private:
+
+            // Topology
+
+            size_t neuron_count;
+            size_t mask_words;
+            size_t stride;                  // mask_words * 64, the length of a charge row
+            std::vector<int> ids;
+            std::vector<std::string> names;
+            std::vector<int> threshold;
+            std::vector<uint64_t> leak;
+            std::vector<uint8_t> is_input;
+            std::vector<uint32_t> outputs;
+
+            // Outgoing synapses of neuron i are [offsets[i], offsets[i+1]) in
+            // each of the syn_ arrays.  A synapse's target is stored as its
+            // offset in the charge matrix from the current row: delay * stride
+            // + to.
+
+            std::vector<uint32_t> offsets;
+            std::vector<uint32_t> syn_offset;
+            std::vector<int> syn_weight;
+            bool distinct_targets;          // No neuron has two synapses to one target
+
+            // State
+
+            uint32_t tracked;
+            std::vector<int> charges;       // tracked rows of stride
+            std::vector<uint64_t> fired;
+            std::vector<int> last_fire;
+            std::vector<uint32_t> fire_counts;
+
+            uint32_t row;
+            uint32_t overall_run_time;
+            uint32_t run_start;
+            int min_potential;
+            int shift;                      // 32 - the width of a charge in bits
+            double spike_value_factor;
+            Kernel kernel;
+
+            static int integer(const double v, const char * what)
+            {
+                if (v != (double) (int) v) {
+                    throw std::runtime_error((std::string) what + " is not an integer");
+                }
+                return (int) v;
+            }
+
+            static neuro::Json property(const char * name, const char type, const int index,
+                    const double min_value, const double max_value)
+            {
+                neuro::Json p = neuro::Json::make(neuro::Json::Object);
+
+                p["name"] = neuro::Json::make_string(name);
+                p["type"] = neuro::Json::make_number(type);
+                p["index"] = neuro::Json::make_number(index);
+                p["size"] = neuro::Json::make_number(1);
+                p["min_value"] = neuro::Json::make_number(min_value);
+                p["max_value"] = neuro::Json::make_number(max_value);
+
+                return p;
+            }
+
+            void load(const risp::Network_Spec & spec)
+            {
+                const risp::Params & p = spec.params;
+
+                check_params(p);
+
+                neuron_count = spec.nodes.size();
+                mask_words = (neuron_count + 63) / 64;
+                stride = mask_words * 64;
+                min_potential = integer(p.min_potential, "min_potential");
+                spike_value_factor = p.spike_value_factor;
+
+                double bound = std::max(fabs(p.min_weight), fabs(p.max_weight));
+
+                bound = std::max(bound, std::max(fabs(p.min_threshold), fabs(p.max_threshold)));
+                bound = std::max(bound, std::max(fabs(p.min_potential), fabs(p.spike_value_factor)));
+
+                shift = (bound <= 127) ? 24 : (bound <= 32767) ? 16 : 0;
+
+                tracked = (p.tracked_timesteps != 0) ? p.tracked_timesteps : p.max_delay + 1;
+
+                if ((int) tracked <= spec.max_edge_delay()) {
+                    throw std::runtime_error("tracked_timesteps must be greater than every delay");
+                }
+
+                if ((uint64_t) tracked * stride > INT_MAX) {
+                    throw std::runtime_error("network is too large for tracked_timesteps");
+                }
+
+                leak.assign(mask_words, 0);
+                is_input.assign(neuron_count, 0);
+
+                for (size_t i = 0; i < neuron_count; i++) {
+
+                    const risp::Node_Spec & n = spec.nodes[i];
+                    char buf[32];
+
+                    snprintf(buf, sizeof(buf), "%d", n.id);
+
+                    ids.push_back(n.id);
+                    names.push_back(n.name == "" ? (std::string) buf : buf + ("(" + n.name + ")"));
+                    threshold.push_back(integer(n.threshold, "threshold"));
+
+                    if (n.leak) {
+                        leak[i / 64] |= (uint64_t) 1 << (i % 64);
+                    }
+                }
+
+                for (size_t i = neuron_count; i < stride; i++) {
+                    threshold.push_back(INT_MAX);
+                    leak[i / 64] |= (uint64_t) 1 << (i % 64);
+                }
+
+                // Counting sort of the edges by source neuron.
+
+                offsets.assign(neuron_count + 1, 0);
+
+                for (size_t i = 0; i < spec.edges.size(); i++) {
+                    offsets[spec.node_index(spec.edges[i].from) + 1]++;
+                }
+
+                for (size_t i = 0; i < neuron_count; i++) {
+                    offsets[i+1] += offsets[i];
+                }
+
+                std::vector<uint32_t> next(offsets.begin(), offsets.end() - 1);
+
+                syn_offset.resize(spec.edges.size());
+                syn_weight.resize(spec.edges.size());
+
+                for (size_t i = 0; i < spec.edges.size(); i++) {
+
+                    const risp::Edge_Spec & e = spec.edges[i];
+                    const uint32_t s = next[spec.node_index(e.from)]++;
+
+                    syn_offset[s] = e.delay * stride + spec.node_index(e.to);
+                    syn_weight[s] = integer(e.weight, "weight");
+                }
+
+                distinct_targets = true;
+
+                for (size_t i = 0; i < neuron_count; i++) {
+                    std::vector<uint32_t> o(syn_offset.begin() + offsets[i],
+                            syn_offset.begin() + offsets[i+1]);
+                    std::sort(o.begin(), o.end());
+                    if (std::adjacent_find(o.begin(), o.end()) != o.end()) {
+                        distinct_targets = false;
+                    }
+                }
+
+                kernel = best_kernel();
+
+                for (size_t i = 0; i < spec.inputs.size(); i++) {
+                    is_input[spec.node_index(spec.inputs[i])] = 1;
+                }
+
+                for (size_t i = 0; i < spec.outputs.size(); i++) {
+                    outputs.push_back(spec.node_index(spec.outputs[i]));
+                }
+
+                charges.assign(tracked * stride, 0);
+                fired.assign(mask_words, 0);
+                last_fire.assign(neuron_count, -1);
+                fire_counts.assign(neuron_count, 0);
+
+                row = 0;
+                overall_run_time = 0;
+                run_start = 0;
+            }
+
+            uint32_t input_index(const int id) const
+            {
+                const std::vector<int>::const_iterator it =
+                    std::lower_bound(ids.begin(), ids.end(), id);
+
+                if (it == ids.end() || *it != id || !is_input[it - ids.begin()]) {
+                    char buf[64];
+                    snprintf(buf, sizeof(buf), "%d is not an input neuron", id);
+                    throw std::runtime_error(buf);
+                }
+
+                return it - ids.begin();
+            }
+
+            // r may be up to 2*tracked - 1.
+
+            int * row_of(uint32_t r)
+            {
+                if (r >= tracked) r -= tracked;
+                return &charges[r * stride];
+            }
+
+            // One timestep, in the phases of markdown/vrisp.md: raise charges to
+            // raise_to and compute the fired mask, carry charge into the next row
+            // for neurons that neither fired nor leak, and clear this row; then
+            // fire down the synapses of fired neurons.
+
+            void step(const uint32_t time, const int raise_to)
+            {
+                int * const c = row_of(row);
+                int * const next = row_of(row + 1);
+
+                switch (kernel) {
+#ifdef VRISP_X86
+                    case AVX512:
+                        fire_and_carry_avx512(c, next, threshold.data(), leak.data(),
+                                fired.data(), mask_words, raise_to, shift);
+                        break;
+                    case AVX2:
+                        fire_and_carry_avx2(c, next, threshold.data(), leak.data(),
+                                fired.data(), mask_words, raise_to, shift);
+                        break;
+#endif
+                    default:
+                        fire_and_carry_scalar(c, next, threshold.data(), leak.data(),
+                                fired.data(), mask_words, raise_to, shift);
+                }
+
+                const Kernel scatter = distinct_targets ? kernel : SCALAR;
+                const uint32_t base = row * stride;
+                const uint32_t total = tracked * stride;
+
+                for (size_t w = 0; w < mask_words; w++) {
+
+                    for (uint64_t f = fired[w]; f != 0; f &= f - 1) {
+
+                        const uint32_t n = w * 64 + __builtin_ctzll(f);
+                        const uint32_t s = offsets[n];
+                        const uint32_t count = offsets[n+1] - s;
+
+                        last_fire[n] = time - run_start;
+                        fire_counts[n]++;
+
+                        switch (scatter) {
+#ifdef VRISP_X86
+                            case AVX512:
+                                scatter_avx512(charges.data(), base, total, &syn_offset[s],
+                                        &syn_weight[s], count);
+                                break;
+                            case AVX2:
+                                scatter_avx2(charges.data(), base, total, &syn_offset[s],
+                                        &syn_weight[s], count);
+                                break;
+#endif
+                            default:
+                                scatter_scalar(charges.data(), base, total, &syn_offset[s],
+                                        &syn_weight[s], count);
+                        }
+                    }
+                }
+
+                row = (row + 1 == tracked) ? 0 : row + 1;
+            }
+
+            void clear_tracking_info()
+            {
+                std::fill(last_fire.begin(), last_fire.end(), -1);
+                std::fill(fire_counts.begin(), fire_counts.end(), 0);
+            }
+    };
+}
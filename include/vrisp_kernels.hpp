@@ -0,0 +1,268 @@
+#pragma once
+
+// The two data-parallel phases of a VRISP timestep, in scalar, AVX2 and
+// AVX-512 versions.  The vector versions are compiled with per-function
+// target attributes, so the rest of the build needs no -m flags, and
+// best_kernel() picks one at run time from what the CPU supports.
+//
+// Both phases work on rows of charges whose length is a multiple of 64
+// (one mask word), so there are no partial vectors.  Padding neurons have
+// an unreachable threshold and are marked as leaking, which keeps them at
+// zero.
+//
+// The first phase vectorizes well; the scatter does not, since its
+// accesses are random, and it dominates once a few percent of the neurons
+// fire.  End to end the vector kernels fall short of 4x over scalar (see
+// README.md and make bench_vrisp).
+
+#include <stdint.h>
+
+#include <algorithm>
+
+#if defined(__x86_64__) || defined(__i386__)
+#define VRISP_X86
+#include <immintrin.h>
+#endif
+
+namespace vrisp
+{
+    typedef enum { SCALAR, AVX2, AVX512 } Kernel;
+
+    inline const char * kernel_name(const Kernel k)
+    {
+        switch (k) {
+            case AVX2: return "avx2";
+            case AVX512: return "avx512";
+            default: return "scalar";
+        }
+    }
+
+    inline bool kernel_supported(const Kernel k)
+    {
+#ifdef VRISP_X86
+        switch (k) {
+            case AVX2: return __builtin_cpu_supports("avx2");
+            case AVX512: return __builtin_cpu_supports("avx512f");
+            default: return true;
+        }
+#else
+        return k == SCALAR;
+#endif
+    }
+
+    inline Kernel best_kernel()
+    {
+        if (kernel_supported(AVX512)) return AVX512;
+        if (kernel_supported(AVX2)) return AVX2;
+        return SCALAR;
+    }
+
+    // Charges are summed as ints but hold only the low 32 - shift bits of the
+    // network's charge width; narrow() sign-extends them, so that they wrap
+    // as a narrower charge would.
+
+    inline int narrow(const int c, const int shift)
+    {
+        return (int) ((uint32_t) c << shift) >> shift;
+    }
+
+    // Phase 1: for each of the words*64 neurons, narrow c[i], raise it to
+    // min_potential and set bit i of fired if it reaches thr[i].  Neurons that
+    // neither fired nor leak add their charge to next[i].  c is left zeroed,
+    // ready for reuse as a future row.  Pass INT_MIN as min_potential to
+    // leave charges unraised.
+
+    inline void fire_and_carry_scalar(int * c, int * next, const int * thr,
+            const uint64_t * leak, uint64_t * fired, const size_t words, const int min_potential,
+            const int shift)
+    {
+        for (size_t w = 0; w < words; w++) {
+
+            const size_t base = w * 64;
+            uint64_t f = 0;
+
+            for (size_t i = 0; i < 64; i++) {
+                const int v = std::max(narrow(c[base+i], shift), min_potential);
+                c[base+i] = v;
+                f |= (uint64_t) (v >= thr[base+i]) << i;
+            }
+
+            fired[w] = f;
+
+            const uint64_t carry = ~(f | leak[w]);
+
+            for (size_t i = 0; i < 64; i++) {
+                next[base+i] += c[base+i] & -(int) ((carry >> i) & 1);
+                c[base+i] = 0;
+            }
+        }
+    }
+
+    // Phase 2: add weight[j] to charges[(base + offset[j]) mod total] for
+    // count synapses.  The offsets of one neuron's synapses must be distinct
+    // for the vector versions, which update them all at once.
+
+    inline void scatter_scalar(int * charges, const uint32_t base, const uint32_t total,
+            const uint32_t * offset, const int * weight, const uint32_t count)
+    {
+        for (uint32_t j = 0; j < count; j++) {
+            uint32_t idx = base + offset[j];
+            if (idx >= total) idx -= total;
+            charges[idx] += weight[j];
+        }
+    }
+
+#ifdef VRISP_X86
+
+    // Eight lanes at a time; leak and fire bits are widened to lane masks by
+    // testing each lane's bit.
+
+    __attribute__((target("avx2")))
+    inline void fire_and_carry_avx2(int * c, int * next, const int * thr,
+            const uint64_t * leak, uint64_t * fired, const size_t words, const int min_potential,
+            const int shift)
+    {
+        const __m256i mp = _mm256_set1_epi32(min_potential);
+        const __m128i sh = _mm_cvtsi32_si128(shift);
+        const __m256i bits = _mm256_setr_epi32(1, 2, 4, 8, 16, 32, 64, 128);
+
+        for (size_t w = 0; w < words; w++) {
+
+            uint64_t f = 0;
+
+            for (size_t k = 0; k < 64; k += 8) {
+
+                const size_t i = w * 64 + k;
+
+                const __m256i v = _mm256_max_epi32(_mm256_sra_epi32(_mm256_sll_epi32(
+                        _mm256_loadu_si256((const __m256i *) (c + i)), sh), sh), mp);
+
+                _mm256_storeu_si256((__m256i *) (c + i), _mm256_setzero_si256());
+
+                const __m256i below = _mm256_cmpgt_epi32(
+                        _mm256_loadu_si256((const __m256i *) (thr + i)), v);
+
+                const uint32_t m = ~_mm256_movemask_ps(_mm256_castsi256_ps(below)) & 0xff;
+                const uint32_t carry = ~(m | (uint32_t) (leak[w] >> k)) & 0xff;
+
+                const __m256i keep = _mm256_cmpeq_epi32(
+                        _mm256_and_si256(_mm256_set1_epi32(carry), bits), bits);
+
+                const __m256i n = _mm256_loadu_si256((const __m256i *) (next + i));
+
+                _mm256_storeu_si256((__m256i *) (next + i),
+                        _mm256_add_epi32(n, _mm256_and_si256(v, keep)));
+
+                f |= (uint64_t) m << k;
+            }
+
+            fired[w] = f;
+        }
+    }
+
+    // AVX2 can gather but not scatter, so indices and sums are computed eight
+    // at a time and stored one by one.
+
+    __attribute__((target("avx2")))
+    inline void scatter_avx2(int * charges, const uint32_t base, const uint32_t total,
+            const uint32_t * offset, const int * weight, const uint32_t count)
+    {
+        const __m256i b = _mm256_set1_epi32(base);
+        const __m256i t = _mm256_set1_epi32(total);
+        const __m256i t1 = _mm256_set1_epi32(total - 1);
+        uint32_t j = 0;
+
+        for (; j + 8 <= count; j += 8) {
+
+            __m256i idx = _mm256_add_epi32(b, _mm256_loadu_si256((const __m256i *) (offset + j)));
+
+            // idx >= total, for indices below 2^31.
+
+            idx = _mm256_sub_epi32(idx, _mm256_and_si256(_mm256_cmpgt_epi32(idx, t1), t));
+
+            const __m256i sum = _mm256_add_epi32(_mm256_i32gather_epi32(charges, idx, 4),
+                    _mm256_loadu_si256((const __m256i *) (weight + j)));
+
+            alignas(32) int32_t is[8];
+            alignas(32) int32_t ss[8];
+
+            _mm256_store_si256((__m256i *) is, idx);
+            _mm256_store_si256((__m256i *) ss, sum);
+
+            for (int l = 0; l < 8; l++) charges[is[l]] = ss[l];
+        }
+
+        scatter_scalar(charges, base, total, offset + j, weight + j, count - j);
+    }
+
+    // GCC's own _mm512_max_epi32 trips -Wmaybe-uninitialized on its
+    // undefined pass-through operand.
+
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wmaybe-uninitialized"
+
+    // Sixteen lanes at a time, with the fire and carry masks used directly as
+    // AVX-512 mask registers.
+
+    __attribute__((target("avx512f")))
+    inline void fire_and_carry_avx512(int * c, int * next, const int * thr,
+            const uint64_t * leak, uint64_t * fired, const size_t words, const int min_potential,
+            const int shift)
+    {
+        const __m512i mp = _mm512_set1_epi32(min_potential);
+        const __m128i sh = _mm_cvtsi32_si128(shift);
+
+        for (size_t w = 0; w < words; w++) {
+
+            uint64_t f = 0;
+
+            for (size_t k = 0; k < 64; k += 16) {
+
+                const size_t i = w * 64 + k;
+
+                const __m512i v = _mm512_max_epi32(_mm512_sra_epi32(_mm512_sll_epi32(
+                        _mm512_loadu_si512(c + i), sh), sh), mp);
+
+                _mm512_storeu_si512(c + i, _mm512_setzero_si512());
+
+                const __mmask16 m = _mm512_cmpge_epi32_mask(v, _mm512_loadu_si512(thr + i));
+                const __mmask16 carry = ~(m | (__mmask16) (leak[w] >> k));
+
+                const __m512i n = _mm512_loadu_si512(next + i);
+
+                _mm512_storeu_si512(next + i, _mm512_mask_add_epi32(n, carry, n, v));
+
+                f |= (uint64_t) m << k;
+            }
+
+            fired[w] = f;
+        }
+    }
+
+    __attribute__((target("avx512f")))
+    inline void scatter_avx512(int * charges, const uint32_t base, const uint32_t total,
+            const uint32_t * offset, const int * weight, const uint32_t count)
+    {
+        const __m512i b = _mm512_set1_epi32(base);
+        const __m512i t = _mm512_set1_epi32(total);
+
+        for (uint32_t j = 0; j < count; j += 16) {
+
+            const __mmask16 m = (count - j >= 16) ? 0xffff : (1 << (count - j)) - 1;
+
+            __m512i idx = _mm512_add_epi32(b, _mm512_maskz_loadu_epi32(m, offset + j));
+
+            idx = _mm512_mask_sub_epi32(idx, _mm512_cmpge_epu32_mask(idx, t), idx, t);
+
+            const __m512i sum = _mm512_add_epi32(
+                    _mm512_mask_i32gather_epi32(_mm512_setzero_si512(), m, idx, charges, 4),
+                    _mm512_maskz_loadu_epi32(m, weight + j));
+
+            _mm512_mask_i32scatter_epi32(charges, m, idx, sum, 4);
+        }
+    }
+
+#pragma GCC diagnostic pop
+
+#endif
+}
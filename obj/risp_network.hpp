@@ -0,0 +1,289 @@
+#pragma once
+
+// Generated by bin/network_to_header from network.txt -- do not edit.
+
+#include "risp.hpp"
+
+namespace risp
+{
+    class Network : public Engine<Network, 15, Policy<LEAK_NONE, true, false, false, false>, Types<int8_t, int8_t, uint8_t, uint8_t>> {
+
+        friend class Engine<Network, 15, Policy<LEAK_NONE, true, false, false, false>, Types<int8_t, int8_t, uint8_t, uint8_t>>;
+
+        public:
+
+            Network()
+            {
+                neuron_count = 40;
+                neurons = neuron_table;
+                neuron_ids = id_table;
+                edges = edge_table;
+                output_neurons = output_table;
+                output_neuron_count = 1;
+
+                spike_value_factor = 7;
+                min_potential = -7;
+                overall_run_time = 0;
+
+                allocate_events(113, 3);
+            }
+
+            ~Network() {}
+
+            void apply_spike_input0(const int time, const double value = 1,
+                    const bool normalized = true)
+            {
+                apply_spike_input(&neuron_table[39], time, value, normalized);
+            }
+
+            void apply_spike_input1(const int time, const double value = 1,
+                    const bool normalized = true)
+            {
+                apply_spike_input(&neuron_table[30], time, value, normalized);
+            }
+
+            void apply_spike_input2(const int time, const double value = 1,
+                    const bool normalized = true)
+            {
+                apply_spike_input(&neuron_table[7], time, value, normalized);
+            }
+
+            void apply_spike(const int id, const int time, const double value = 1,
+                    const bool normalized = true)
+            {
+                switch (id) {
+
+                    case 0:
+                        apply_spike_input0(time, value, normalized);
+                        break;
+
+                    case 1:
+                        apply_spike_input1(time, value, normalized);
+                        break;
+
+                    case 2:
+                        apply_spike_input2(time, value, normalized);
+                        break;
+
+                    default: {
+                        char buf[64];
+                        snprintf(buf, sizeof(buf), "%d is not an input neuron", id);
+                        throw std::runtime_error(buf);
+                    }
+                }
+            }
+
+        private:
+
+            void reset_neurons()
+            {
+                reset_neuron(neuron_table[0]);
+                reset_neuron(neuron_table[1]);
+                reset_neuron(neuron_table[2]);
+                reset_neuron(neuron_table[3]);
+                reset_neuron(neuron_table[4]);
+                reset_neuron(neuron_table[5]);
+                reset_neuron(neuron_table[6]);
+                reset_neuron(neuron_table[7]);
+                reset_neuron(neuron_table[8]);
+                reset_neuron(neuron_table[9]);
+                reset_neuron(neuron_table[10]);
+                reset_neuron(neuron_table[11]);
+                reset_neuron(neuron_table[12]);
+                reset_neuron(neuron_table[13]);
+                reset_neuron(neuron_table[14]);
+                reset_neuron(neuron_table[15]);
+                reset_neuron(neuron_table[16]);
+                reset_neuron(neuron_table[17]);
+                reset_neuron(neuron_table[18]);
+                reset_neuron(neuron_table[19]);
+                reset_neuron(neuron_table[20]);
+                reset_neuron(neuron_table[21]);
+                reset_neuron(neuron_table[22]);
+                reset_neuron(neuron_table[23]);
+                reset_neuron(neuron_table[24]);
+                reset_neuron(neuron_table[25]);
+                reset_neuron(neuron_table[26]);
+                reset_neuron(neuron_table[27]);
+                reset_neuron(neuron_table[28]);
+                reset_neuron(neuron_table[29]);
+                reset_neuron(neuron_table[30]);
+                reset_neuron(neuron_table[31]);
+                reset_neuron(neuron_table[32]);
+                reset_neuron(neuron_table[33]);
+                reset_neuron(neuron_table[34]);
+                reset_neuron(neuron_table[35]);
+                reset_neuron(neuron_table[36]);
+                reset_neuron(neuron_table[37]);
+                reset_neuron(neuron_table[38]);
+                reset_neuron(neuron_table[39]);
+            }
+
+            Neuron neuron_table[40] = {
+                Neuron(3, false, 0, 1),         // n88
+                Neuron(3, false, 1, 2),         // n7
+                Neuron(7, false, 2, 3),         // n42
+                Neuron(5, false, 3, 5),         // n67
+                Neuron(7, false, 5, 7),         // n68
+                Neuron(6, false, 7, 8),         // n34
+                Neuron(4, false, 8, 9),         // n15
+                Neuron(6, false, 9, 15),        // n2
+                Neuron(3, false, 15, 18),       // n30
+                Neuron(2, false, 18, 23),       // n11
+                Neuron(0, false, 23, 29),       // n6
+                Neuron(4, false, 29, 33),       // n80
+                Neuron(3, false, 33, 35),       // n101
+                Neuron(3, false, 35, 40),       // n51
+                Neuron(6, false, 40, 43),       // n10
+                Neuron(2, false, 43, 46),       // n32
+                Neuron(0, false, 46, 47),       // n3
+                Neuron(7, false, 47, 49),       // n16
+                Neuron(3, false, 49, 51),       // n77
+                Neuron(7, false, 51, 54),       // n5
+                Neuron(7, false, 54, 56),       // n20
+                Neuron(0, false, 56, 63),       // n9
+                Neuron(3, false, 63, 64),       // n93
+                Neuron(4, false, 64, 66),       // n33
+                Neuron(2, false, 66, 67),       // n62
+                Neuron(5, false, 67, 69),       // n102
+                Neuron(0, false, 69, 72),       // n12
+                Neuron(2, false, 72, 75),       // n64
+                Neuron(5, false, 75, 76),       // n41
+                Neuron(3, false, 76, 82),       // n8
+                Neuron(1, false, 82, 87),       // n1
+                Neuron(4, false, 87, 89),       // n26
+                Neuron(4, false, 89, 94),       // n60
+                Neuron(0, false, 94, 98),       // n13
+                Neuron(5, false, 98, 99),       // n95
+                Neuron(6, false, 99, 103),      // n4
+                Neuron(7, false, 103, 105),     // n17
+                Neuron(6, false, 105, 106),     // n22
+                Neuron(3, false, 106, 107),     // n18
+                Neuron(3, false, 107, 113),     // n0
+            };
+
+            static constexpr int id_table[40] = { 88, 7, 42, 67, 68, 34, 15, 2, 30, 11, 6, 80, 101, 51, 10, 32, 3, 16, 77, 5, 20, 9, 93, 33, 62, 102, 12, 64, 41, 8, 1, 26, 60, 13, 95, 4, 17, 22, 18, 0 };
+
+            static constexpr uint32_t output_table[1] = { 16 };
+
+            static constexpr edge_t edge_table[113] = {
+                { 2, 14, 14 },                  // n88 -> n10
+                { 1, 11, 15 },                  // n7 -> n32
+                { 4, 6, 19 },                   // n42 -> n5
+                { 3, 10, 25 },                  // n67 -> n102
+                { 5, 13, 21 },                  // n67 -> n9
+                { 6, 7, 9 },                    // n68 -> n11
+                { -2, 13, 26 },                 // n68 -> n12
+                { 1, 10, 1 },                   // n34 -> n7
+                { 1, 10, 14 },                  // n15 -> n10
+                { 1, 2, 2 },                    // n2 -> n42
+                { 3, 7, 29 },                   // n2 -> n8
+                { 6, 7, 18 },                   // n2 -> n77
+                { 2, 9, 16 },                   // n2 -> n3
+                { 3, 14, 10 },                  // n2 -> n6
+                { 2, 14, 3 },                   // n2 -> n67
+                { 5, 5, 11 },                   // n30 -> n80
+                { 0, 9, 15 },                   // n30 -> n32
+                { -5, 14, 12 },                 // n30 -> n101
+                { -2, 5, 1 },                   // n11 -> n7
+                { -7, 8, 29 },                  // n11 -> n8
+                { -7, 9, 25 },                  // n11 -> n102
+                { 2, 12, 28 },                  // n11 -> n41
+                { 3, 14, 10 },                  // n11 -> n6
+                { 6, 2, 31 },                   // n6 -> n26
+                { 2, 3, 21 },                   // n6 -> n9
+                { 0, 3, 14 },                   // n6 -> n10
+                { -1, 10, 13 },                 // n6 -> n51
+                { 3, 12, 29 },                  // n6 -> n8
+                { -6, 15, 0 },                  // n6 -> n88
+                { 3, 6, 14 },                   // n80 -> n10
+                { -3, 6, 31 },                  // n80 -> n26
+                { 0, 9, 5 },                    // n80 -> n34
+                { 1, 11, 15 },                  // n80 -> n32
+                { 2, 2, 31 },                   // n101 -> n26
+                { 1, 4, 14 },                   // n101 -> n10
+                { -7, 1, 30 },                  // n51 -> n1
+                { 0, 12, 32 },                  // n51 -> n60
+                { 0, 14, 9 },                   // n51 -> n11
+                { -4, 14, 5 },                  // n51 -> n34
+                { 1, 15, 29 },                  // n51 -> n8
+                { -2, 3, 30 },                  // n10 -> n1
+                { 1, 4, 4 },                    // n10 -> n68
+                { -7, 15, 28 },                 // n10 -> n41
+                { 1, 1, 5 },                    // n32 -> n34
+                { -4, 14, 7 },                  // n32 -> n2
+                { -2, 14, 32 },                 // n32 -> n60
+                { -7, 13, 17 },                 // n3 -> n16
+                { 0, 1, 24 },                   // n16 -> n62
+                { 3, 8, 33 },                   // n16 -> n13
+                { 3, 8, 34 },                   // n77 -> n95
+                { 2, 14, 12 },                  // n77 -> n101
+                { 2, 1, 33 },                   // n5 -> n13
+                { 4, 9, 34 },                   // n5 -> n95
+                { 7, 12, 22 },                  // n5 -> n93
+                { 3, 7, 6 },                    // n20 -> n15
+                { 2, 8, 34 },                   // n20 -> n95
+                { -5, 3, 3 },                   // n9 -> n67
+                { 0, 4, 7 },                    // n9 -> n2
+                { 5, 4, 31 },                   // n9 -> n26
+                { -1, 7, 35 },                  // n9 -> n4
+                { 6, 9, 20 },                   // n9 -> n20
+                { -5, 12, 13 },                 // n9 -> n51
+                { -2, 15, 18 },                 // n9 -> n77
+                { 1, 1, 26 },                   // n93 -> n12
+                { 4, 9, 8 },                    // n33 -> n30
+                { -5, 15, 13 },                 // n33 -> n51
+                { 7, 5, 35 },                   // n62 -> n4
+                { 7, 8, 30 },                   // n102 -> n1
+                { -3, 11, 8 },                  // n102 -> n30
+                { -4, 3, 11 },                  // n12 -> n80
+                { 3, 10, 36 },                  // n12 -> n17
+                { 0, 12, 29 },                  // n12 -> n8
+                { -1, 6, 34 },                  // n64 -> n95
+                { -2, 12, 33 },                 // n64 -> n13
+                { 4, 14, 16 },                  // n64 -> n3
+                { 6, 6, 18 },                   // n41 -> n77
+                { -2, 1, 7 },                   // n8 -> n2
+                { 5, 3, 5 },                    // n8 -> n34
+                { 0, 4, 39 },                   // n8 -> n0
+                { 7, 5, 13 },                   // n8 -> n51
+                { -3, 6, 6 },                   // n8 -> n15
+                { -2, 14, 21 },                 // n8 -> n9
+                { 1, 3, 16 },                   // n1 -> n3
+                { -1, 6, 7 },                   // n1 -> n2
+                { -6, 12, 9 },                  // n1 -> n11
+                { 1, 13, 8 },                   // n1 -> n30
+                { -3, 14, 36 },                 // n1 -> n17
+                { 2, 1, 9 },                    // n26 -> n11
+                { 1, 15, 18 },                  // n26 -> n77
+                { -4, 8, 36 },                  // n60 -> n17
+                { -5, 9, 39 },                  // n60 -> n0
+                { 6, 9, 14 },                   // n60 -> n10
+                { 2, 11, 31 },                  // n60 -> n26
+                { -6, 12, 22 },                 // n60 -> n93
+                { 4, 2, 30 },                   // n13 -> n1
+                { 5, 3, 16 },                   // n13 -> n3
+                { -6, 4, 31 },                  // n13 -> n26
+                { 3, 15, 35 },                  // n13 -> n4
+                { 6, 8, 32 },                   // n95 -> n60
+                { 5, 3, 35 },                   // n4 -> n4
+                { 1, 4, 22 },                   // n4 -> n93
+                { 1, 6, 23 },                   // n4 -> n33
+                { 2, 15, 39 },                  // n4 -> n0
+                { 4, 1, 25 },                   // n17 -> n102
+                { 2, 10, 39 },                  // n17 -> n0
+                { -1, 13, 27 },                 // n22 -> n64
+                { -3, 8, 28 },                  // n18 -> n41
+                { 7, 1, 31 },                   // n0 -> n26
+                { -4, 3, 30 },                  // n0 -> n1
+                { 3, 8, 33 },                   // n0 -> n13
+                { 4, 14, 38 },                  // n0 -> n18
+                { -2, 14, 34 },                 // n0 -> n95
+                { -5, 15, 37 },                 // n0 -> n22
+            };
+    };
+
+    constexpr int Network::id_table[40];
+    constexpr uint32_t Network::output_table[1];
+    constexpr Network::edge_t Network::edge_table[113];
+}
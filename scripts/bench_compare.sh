@@ -0,0 +1,47 @@
+# Script to reproduce a change's before and after benchmark numbers: it builds
+# bin/risp_benchmark as it was at git revision rev (in a temporary worktree)
+# and as it is in this tree, and runs the two in turn, several times each,
+# on the same network and input.  Timings are noisy, so compare the rounds
+# rather than any single run.  The benchmark exists from the commit that
+# added risp::Runtime_Network on.
+
+if [ $# -gt 4 ]; then
+  echo 'usage: sh scripts/bench_compare.sh [rev] [network_json] [input_file] [rounds]' >&2
+  exit 1
+fi
+
+rev="${1:-HEAD}"
+network="${2:-network.txt}"
+input="${3:-full_input.txt}"
+rounds="${4:-3}"
+
+for f in "$network" "$input" ; do
+  if [ ! -f "$f" ]; then
+    echo "Error -- no file $f" >&2
+    exit 1
+  fi
+done
+
+case "$network" in
+  /*) abs_network="$network" ;;
+  *) abs_network="`pwd`/$network" ;;
+esac
+
+tmp=`mktemp -d`
+trap 'git worktree remove --force "$tmp/tree" >/dev/null 2>&1; rm -rf "$tmp"' 0
+
+git worktree add --detach "$tmp/tree" "$rev" >/dev/null 2>&1 || exit 1
+
+( cd "$tmp/tree" && make NETWORK="$abs_network" bin/risp_benchmark ) \
+    >"$tmp/make.txt" 2>&1 || { cat "$tmp/make.txt" >&2 ; exit 1 ; }
+
+make NETWORK="$network" bin/risp_benchmark >/dev/null || exit 1
+
+i=1
+while [ $i -le $rounds ]; do
+  echo "== $rev, round $i"
+  "$tmp/tree/bin/risp_benchmark" "$network" "$input"
+  echo "== working tree, round $i"
+  bin/risp_benchmark "$network" "$input"
+  i=`expr $i + 1`
+done
@@ -0,0 +1,112 @@
+# Script to measure what the neuron layout (Network_Spec::locality_order())
+# buys on a large network.  It generates a network of neurons on a ring, each
+# with synapses to neurons at most radius places away, and gives the neurons
+# shuffled ids, so that file order has no locality and a good layout has to
+# recover it.  Then it builds bin/processor_tool_risp_runtime as it was at
+# git revisions before and after (in temporary worktrees), and times each in
+# turn on the network, several times each.  Loading the network takes as
+# long as a few hundred timesteps, so each round also times loading it alone,
+# and reports the difference as the time spent running.
+#
+# To see the layout's effect alone, give the commit that added
+# locality_order() as after and its parent as before, e.g. rev^ rev.
+
+if [ $# -lt 2 -o $# -gt 6 ]; then
+  echo 'usage: sh scripts/bench_locality.sh before after [neurons] [fan_out] [radius] [rounds]' >&2
+  exit 1
+fi
+
+before="$1"
+after="$2"
+neurons="${3:-100000}"
+fan_out="${4:-10}"
+radius="${5:-64}"
+rounds="${6:-3}"
+
+tmp=`mktemp -d`
+trap 'for t in before after ; do git worktree remove --force "$tmp/$t" >/dev/null 2>&1 ; done
+      rm -rf "$tmp"' 0
+
+# The network: ids[i] is the id of the neuron at ring position i.  Twenty
+# inputs and twenty outputs are spread around the ring, each output just
+# past an input.
+
+awk -v n="$neurons" -v f="$fan_out" -v r="$radius" 'BEGIN {
+  srand(7)
+  for (i = 0; i < n; i++) ids[i] = i
+  for (i = n - 1; i > 0; i--) { j = int(rand() * (i + 1)); t = ids[i]; ids[i] = ids[j]; ids[j] = t }
+  split("3 4 6 6 -4", w, " ")
+
+  print "{ \"Properties\":"
+  print "  { \"node_properties\": ["
+  print "      { \"name\":\"Threshold\", \"type\":73, \"index\":0, \"size\":1, \"min_value\":0.0, \"max_value\":7.0 }],"
+  print "    \"edge_properties\": ["
+  print "      { \"name\":\"Delay\", \"type\":73, \"index\":1, \"size\":1, \"min_value\":1.0, \"max_value\":15.0 },"
+  print "      { \"name\":\"Weight\", \"type\":73, \"index\":0, \"size\":1, \"min_value\":-7.0, \"max_value\":7.0 }],"
+  print "    \"network_properties\": [] },"
+
+  printf " \"Nodes\": ["
+  for (i = 0; i < n; i++) printf "%s\n  {\"id\":%d,\"values\":[5.0]}", (i == 0) ? "" : ",", i
+  printf " ],\n \"Edges\": ["
+
+  for (i = 0; i < n; i++) {
+    for (k = 0; k < f; k++) {
+      d = int(rand() * (2 * r + 1)) - r
+      if (d == 0) d = 1
+      printf "%s\n  {\"from\":%d,\"to\":%d,\"values\":[%d.0,%d.0]}", (i + k == 0) ? "" : ",",
+        ids[i], ids[(i + d + n) % n], w[int(rand() * 5) + 1], int(rand() * 15) + 1
+    }
+  }
+
+  printf " ],\n \"Inputs\": ["
+  for (i = 0; i < 20; i++) printf "%s%d", (i == 0) ? "" : ", ", ids[int(i * n / 20)]
+  printf "],\n \"Outputs\": ["
+  for (i = 0; i < 20; i++) printf "%s%d", (i == 0) ? "" : ", ", ids[int(i * n / 20) + 16]
+  print "],"
+  print " \"Network_Values\": [],"
+  print " \"Associated_Data\": { \"other\": {\"proc_name\":\"risp\"},"
+  print "   \"proc_params\": { \"discrete\": true, \"fire_like_ravens\": false, \"leak_mode\": \"none\","
+  print "     \"max_delay\": 15, \"max_threshold\": 7.0, \"max_weight\": 7.0, \"min_potential\": -7.0,"
+  print "     \"min_threshold\": 0.0, \"min_weight\": -7.0, \"run_time_inclusive\": false,"
+  print "     \"spike_value_factor\": 7.0, \"threshold_inclusive\": false } } }"
+
+  # The input: three episodes of 300 timesteps, with spikes on every input
+  # for the first 200.
+
+  for (e = 0; e < 3; e++) {
+    print "CA" > "/dev/stderr"
+    for (t = 0; t < 200; t += 10) {
+      for (i = 0; i < 20; i++) printf "AS %d %d 1\n", ids[int(i * n / 20)], t > "/dev/stderr"
+    }
+    print "RUN 300" > "/dev/stderr"
+    print "OC" > "/dev/stderr"
+  }
+}' > "$tmp/network.json" 2> "$tmp/commands.txt"
+
+echo ML "$tmp/network.json" > "$tmp/load.txt"
+cat "$tmp/load.txt" "$tmp/commands.txt" > "$tmp/input.txt"
+
+for t in before after ; do
+  eval rev=\$$t
+  git worktree add --detach "$tmp/$t" "$rev" >/dev/null 2>&1 || exit 1
+  ( cd "$tmp/$t" && make bin/processor_tool_risp_runtime ) \
+      >"$tmp/make.txt" 2>&1 || { cat "$tmp/make.txt" >&2 ; exit 1 ; }
+done
+
+echo "$neurons neurons, $fan_out synapses each, radius $radius"
+
+i=1
+while [ $i -le $rounds ]; do
+  for t in before after ; do
+    eval rev=\$$t
+    tool="$tmp/$t/bin/processor_tool_risp_runtime"
+    start=`date +%s%N`
+    "$tool" < "$tmp/load.txt" > /dev/null
+    loaded=`date +%s%N`
+    fires=`"$tool" < "$tmp/input.txt" | awk '{ s += $NF } END { print s }'`
+    end=`date +%s%N`
+    echo "$rev, round $i: load `expr \( $loaded - $start \) / 1000000` ms," \
+         "run `expr \( $end - $loaded - $loaded + $start \) / 1000000` ms, $fires output fires"
+  done
+  i=`expr $i + 1`
+done
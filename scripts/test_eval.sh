@@ -0,0 +1,52 @@
+# Script to check processor_tool_risp_runtime's EVAL command against running
+# the same episodes one by one with CA, AS/ASV, RUN and OC.  The episodes
+# use normalized values other than 1 and unnormalized ASV values, so a
+# simulator that drops spike values fails.  The network's inputs must
+# include node ids 0 and 1.
+
+if [ $# -gt 1 ]; then
+  echo 'usage: sh scripts/test_eval.sh [network_json]' >&2
+  exit 1
+fi
+
+network="${1:-network.txt}"
+
+if [ ! -f "$network" ]; then
+  echo "Error -- no file $network" >&2
+  exit 1
+fi
+
+if [ ! -x bin/processor_tool_risp_runtime ]; then make bin/processor_tool_risp_runtime ; fi
+
+# Eight episodes of spikes at varying values and times.
+
+awk 'BEGIN { for (e = 0; e < 8; e++) {
+               for (t = 0; t < 40; t += 2 + e % 3) {
+                 printf "AS 0 %d %.2f\n", t, ((t + e) % 9 - 4) / 4
+                 if (t % 4 == 0) printf "ASV 1 %d %d\n", t + 1, (t + 3 * e) % 11 - 4
+               }
+               printf "RUN %d\n", 50 + 10 * e
+           } }' > tmp_eval_episodes.txt
+
+printf 'EVAL 2 tmp_eval_episodes.txt %s\n' "$network" | bin/processor_tool_risp_runtime \
+    > tmp_eval_output.txt
+
+# The same, one episode at a time.  OC prints a line per output, which are
+# gathered into EVAL's "network episode: counts" lines.
+
+outputs=`head -n 1 tmp_eval_output.txt | awk '{ print NF - 2 }'`
+
+( echo ML "$network"
+  echo CA
+  awk '{ print } $1 == "RUN" { print "OC" ; print "CA" }' tmp_eval_episodes.txt ) |
+  bin/processor_tool_risp_runtime |
+  awk -v k="$outputs" '{ c = c " " $NF ; if (NR % k == 0) { printf "0 %d:%s\n", NR / k - 1, c ; c = "" } }' \
+    > tmp_eval_correct.txt
+
+if ! cmp -s tmp_eval_output.txt tmp_eval_correct.txt ; then
+  echo "Failed -- EVAL output (tmp_eval_output.txt) differs from tmp_eval_correct.txt" >&2
+  exit 1
+fi
+
+echo "EVAL matches sequential runs on $network"
+rm -f tmp_eval_episodes.txt tmp_eval_output.txt tmp_eval_correct.txt
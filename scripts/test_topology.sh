@@ -0,0 +1,36 @@
+# Script to check that the RISP simulators' synapse tables match a network
+# file: every edge once, with its weight and delay.  bin/processor_tool_risp
+# must have been built for the same network (make NETWORK=...).
+
+if [ $# -gt 1 ]; then
+  echo 'usage: sh scripts/test_topology.sh [network_json]' >&2
+  exit 1
+fi
+
+network="${1:-network.txt}"
+
+if [ ! -f "$network" ]; then
+  echo "Error -- no file $network" >&2
+  exit 1
+fi
+
+for i in bin/processor_tool_risp bin/processor_tool_risp_runtime ; do
+  if [ ! -x $i ]; then make $i ; fi
+done
+
+status=0
+
+for i in bin/processor_tool_risp bin/processor_tool_risp_runtime ; do
+  out=`printf 'ML %s\nTC %s\n' "$network" "$network" | $i`
+  echo "$i: $out"
+  case "$out" in
+    *": matches $network") ;;
+    *) status=1 ;;
+  esac
+done
+
+if [ $status -ne 0 ]; then
+  echo "Failed -- topology differs from $network" >&2
+fi
+
+exit $status
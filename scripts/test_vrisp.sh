@@ -13,8 +13,18 @@ fi
 
 t="$1"
 
+# Some test directories (e.g. 49 and 50) lack their processor_tool.txt or
+# correct_output.txt, so '-' runs only the complete ones.
+
 if [ T"$t" = 'T-' ]; then
-  t=`ls vrisp_testing`
+  t=""
+  for i in `ls vrisp_testing` ; do
+    if [ -f vrisp_testing/$i/processor_tool.txt -a -f vrisp_testing/$i/correct_output.txt ]; then
+      t="$t $i"
+    else
+      echo "Skipping Test $i - it is missing files" >&2
+    fi
+  done
 fi
 
 # Make the two executables if they aren't made yet.
@@ -0,0 +1,381 @@
+// Emits a header that specializes risp::Network for one network JSON: a
+// table of neurons, one packed edge table sorted by source neuron and delay,
+// and unrolled per-neuron loops.  Neurons are laid out in
+// Network_Spec::locality_order(), and table entries are commented with node
+// ids.  The tables that never change are static constexpr class data, defined
+// after the class, so the header belongs in one translation unit; only
+// neuron_table is per instance.
+//
+// With noise and a noisy_seed of 0, the seed is drawn when the header is
+// generated.
+//
+// usage: network_to_header network_json [params_json] > risp_network.hpp
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <stdexcept>
+
+#include "risp_spec.hpp"
+
+using namespace std;
+
+// The neuron_table entry of node id, where table_index[i] is the position in
+// neuron_table of spec.nodes[i].
+
+static string neuron(const risp::Network_Spec & spec, const vector <uint32_t> & table_index,
+        const int id)
+{
+    ostringstream ss;
+    ss << "neuron_table[" << table_index[spec.node_index(id)] << "]";
+    return ss.str();
+}
+
+static int integer(const double v, const char * what)
+{
+    if (v != rint(v)) {
+        ostringstream ss;
+        ss << what << " " << v << " is not an integer";
+        throw runtime_error(ss.str());
+    }
+
+    return (int) v;
+}
+
+// A charge, threshold or weight as a literal: an integer when the params are
+// discrete, and otherwise a double that the compiler rounds to float.
+
+static string value(const risp::Params & p, const double v, const char * what)
+{
+    if (p.discrete) return to_string(integer(v, what));
+
+    char s[32];
+    snprintf(s, sizeof(s), "%.17g", v);
+    return s;
+}
+
+// method() calls call(neuron) on every neuron.
+
+static void emit_unrolled(const risp::Network_Spec & spec, const char * method,
+        const char * call)
+{
+    printf("            void %s()\n", method);
+    printf("            {\n");
+
+    for (size_t k = 0; k < spec.nodes.size(); k++) {
+        printf("                %s(neuron_table[%lu]);\n", call, k);
+    }
+
+    printf("            }\n\n");
+}
+
+// The Policy type for the params.
+
+static string policy(const risp::Params & p)
+{
+    const char * leak = (p.leak_mode == "all") ? "LEAK_ALL" :
+        (p.leak_mode == "configurable") ? "LEAK_CONFIGURABLE" : "LEAK_NONE";
+
+    ostringstream ss;
+
+    ss << "Policy<" << leak << ", " << (p.threshold_inclusive ? "true" : "false")
+        << ", " << (p.run_time_inclusive ? "true" : "false")
+        << ", " << (p.inputs_from_weights ? "true" : "false")
+        << ", " << (p.noisy() ? "true" : "false") << ">";
+
+    return ss.str();
+}
+
+// The narrowest signed type that holds -bound..bound.
+
+static const char * signed_type(const double bound, const char * what)
+{
+    if (bound <= 127) return "int8_t";
+    if (bound <= 32767) return "int16_t";
+    if (bound <= 2147483647.0) return "int";
+
+    throw runtime_error(string(what) + " range does not fit in 32 bits");
+}
+
+// The narrowest unsigned type that holds 0..max.
+
+static const char * unsigned_type(const size_t max)
+{
+    return (max <= 255) ? "uint8_t" : (max <= 65535) ? "uint16_t" : "uint32_t";
+}
+
+// The Types for the network.  RISP-F networks use floats.  Otherwise weights
+// and thresholds must hold the params' ranges and the network's own values.
+// Charges must also hold a timestep's worth of input to the neuron with the
+// most incoming synapses, plus one input spike, so that only piled-up input
+// spikes can saturate them.  Noise never moves a weight by more than four
+// standard deviations.
+
+static string types(const risp::Network_Spec & spec)
+{
+    const risp::Params & p = spec.params;
+
+    double weight = max(fabs(p.min_weight), fabs(p.max_weight));
+    double charge = max(fabs(p.min_potential), max(fabs(p.min_threshold), fabs(p.max_threshold)));
+    double noise = 0;
+    map <int, int> fan_in;
+    int max_fan_in = 0;
+
+    for (size_t i = 0; i < p.weights.size(); i++) weight = max(weight, fabs(p.weights[i]));
+
+    for (size_t i = 0; i < spec.edges.size(); i++) {
+        weight = max(weight, fabs(spec.edges[i].weight));
+        noise = max(noise, 4 * spec.edges[i].stddev);
+        max_fan_in = max(max_fan_in, ++fan_in[spec.edges[i].to]);
+    }
+
+    for (size_t i = 0; i < spec.nodes.size(); i++) {
+        charge = max(charge, fabs(spec.nodes[i].threshold) + 1);
+    }
+
+    charge += max_fan_in * (weight + ceil(noise)) + max(weight, fabs(p.spike_value_factor));
+
+    ostringstream ss;
+
+    if (!p.discrete) {
+        ss << "Types<float, float, ";
+    }
+    else {
+        ss << "Types<" << signed_type(charge, "charge") << ", " << signed_type(weight, "weight")
+            << ", ";
+    }
+
+    ss << unsigned_type(spec.max_edge_delay()) << ", " << unsigned_type(spec.nodes.size() - 1)
+        << ">";
+
+    return ss.str();
+}
+
+static void emit(const risp::Network_Spec & spec, const string & network_file,
+        const string & params_file)
+{
+    const risp::Params & p = spec.params;
+    const size_t n = spec.nodes.size();
+    ostringstream definitions;          // Of the static tables, after the class
+
+    if (n == 0) throw runtime_error("network has no neurons");
+
+    const vector <uint32_t> nodes = spec.locality_order();
+
+    vector <uint32_t> table_index(n);
+
+    for (size_t k = 0; k < n; k++) table_index[nodes[k]] = k;
+
+    // The edges, sorted by source neuron, then by delay so that a fire
+    // appends to each bucket in one run, and otherwise in file order.
+
+    vector <size_t> offsets(n+1, 0);
+    vector <size_t> order(spec.edges.size());
+
+    for (size_t i = 0; i < spec.edges.size(); i++) {
+        offsets[table_index[spec.node_index(spec.edges[i].from)] + 1]++;
+    }
+
+    for (size_t i = 0; i < n; i++) offsets[i+1] += offsets[i];
+
+    vector <size_t> next(offsets.begin(), offsets.end() - 1);
+
+    for (size_t i = 0; i < spec.edges.size(); i++) {
+        order[next[table_index[spec.node_index(spec.edges[i].from)]]++] = i;
+    }
+
+    for (size_t k = 0; k < n; k++) {
+        stable_sort(order.begin() + offsets[k], order.begin() + offsets[k+1],
+                [&spec](const size_t x, const size_t y) {
+                    return spec.edges[x].delay < spec.edges[y].delay;
+                });
+    }
+
+    printf("#pragma once\n\n");
+    printf("// Generated by bin/network_to_header from %s%s%s -- do not edit.\n\n",
+            network_file.c_str(), params_file == "" ? "" : " and ", params_file.c_str());
+    printf("#include \"risp.hpp\"\n\n");
+    printf("namespace risp\n{\n");
+    const string engine = "Engine<Network, " + to_string(spec.max_edge_delay()) + ", " +
+        policy(p) + ", " + types(spec) + ">";
+
+    printf("    class Network : public %s {\n\n", engine.c_str());
+    printf("        friend class %s;\n\n", engine.c_str());
+    printf("        public:\n\n");
+
+    // Constructor: the tables, then parameters.
+
+    printf("            Network()\n");
+    printf("            {\n");
+    printf("                neuron_count = %lu;\n", n);
+    printf("                neurons = neuron_table;\n");
+    printf("                neuron_ids = id_table;\n");
+    printf("                edges = edge_table;\n");
+    printf("                output_neurons = output_table;\n");
+    printf("                output_neuron_count = %lu;\n", spec.outputs.size());
+
+    if (p.noisy()) {
+        printf("                edge_ids = edge_id_table;\n");
+        printf("                edge_stddevs = edge_stddev_table;\n");
+    }
+
+    printf("\n");
+    printf("                spike_value_factor = %s;\n",
+            value(p, p.spike_value_factor, "spike_value_factor").c_str());
+    printf("                min_potential = %s;\n",
+            value(p, p.min_potential, "min_potential").c_str());
+
+    if (p.inputs_from_weights) {
+        printf("                input_weights = weights;\n");
+        printf("                input_weight_count = %lu;\n", p.weights.size());
+    }
+
+    if (p.noisy()) {
+        printf("                noisy_seed = %lld;\n", (long long) p.noisy_seed);
+    }
+
+    printf("                overall_run_time = 0;\n\n");
+    printf("                allocate_events(%lu, %lu);\n", spec.edges.size(), spec.inputs.size());
+    printf("            }\n\n");
+    printf("            ~Network() {}\n\n");
+
+    // Input entry points, by node id, plus a dispatcher for the tools.
+
+    for (size_t i = 0; i < spec.inputs.size(); i++) {
+        printf("            void apply_spike_input%d(const int time, const double value = 1,\n",
+                spec.inputs[i]);
+        printf("                    const bool normalized = true)\n");
+        printf("            {\n");
+        printf("                apply_spike_input(&%s, time, value, normalized);\n",
+                neuron(spec, table_index, spec.inputs[i]).c_str());
+        printf("            }\n\n");
+    }
+
+    printf("            void apply_spike(const int id, const int time, const double value = 1,\n");
+    printf("                    const bool normalized = true)\n");
+    printf("            {\n");
+    printf("                switch (id) {\n\n");
+
+    for (size_t i = 0; i < spec.inputs.size(); i++) {
+        printf("                    case %d:\n", spec.inputs[i]);
+        printf("                        apply_spike_input%d(time, value, normalized);\n",
+                spec.inputs[i]);
+        printf("                        break;\n\n");
+    }
+
+    printf("                    default: {\n");
+    printf("                        char buf[64];\n");
+    printf("                        snprintf(buf, sizeof(buf), \"%%d is not an input neuron\", id);\n");
+    printf("                        throw std::runtime_error(buf);\n");
+    printf("                    }\n");
+    printf("                }\n");
+    printf("            }\n\n");
+
+    printf("        private:\n\n");
+
+    emit_unrolled(spec, "reset_neurons", "reset_neuron");
+
+    if (p.inputs_from_weights) {
+        printf("            static constexpr charge_t weights[%lu] = {", p.weights.size());
+        definitions << "    constexpr Network::charge_t Network::weights[" << p.weights.size()
+            << "];\n";
+        for (size_t i = 0; i < p.weights.size(); i++) {
+            printf("%s%s", i == 0 ? " " : ", ", value(p, p.weights[i], "weight").c_str());
+        }
+        printf(" };\n\n");
+    }
+
+    printf("            Neuron neuron_table[%lu] = {\n", n);
+
+    for (size_t k = 0; k < n; k++) {
+        const risp::Node_Spec & nd = spec.nodes[nodes[k]];
+        const string entry = "Neuron(" + value(p, nd.threshold, "threshold") +
+            (nd.leak ? ", true, " : ", false, ") + to_string(offsets[k]) + ", " +
+            to_string(offsets[k+1]) + "),";
+        printf("                %-32s// n%d\n", entry.c_str(), nd.id);
+    }
+
+    printf("            };\n\n");
+
+    printf("            static constexpr int id_table[%lu] = {", n);
+    definitions << "    constexpr int Network::id_table[" << n << "];\n";
+    for (size_t k = 0; k < n; k++) printf("%s%d", k == 0 ? " " : ", ", spec.nodes[nodes[k]].id);
+    printf(" };\n\n");
+
+    // The output neurons, by index.  A network with no outputs still gets a
+    // one-entry table.
+
+    printf("            static constexpr uint32_t output_table[%lu] = {",
+            max((size_t) 1, spec.outputs.size()));
+    definitions << "    constexpr uint32_t Network::output_table[" <<
+        max((size_t) 1, spec.outputs.size()) << "];\n";
+    for (size_t i = 0; i < spec.outputs.size(); i++) {
+        printf("%s%u", i == 0 ? " " : ", ", table_index[spec.node_index(spec.outputs[i])]);
+    }
+    printf("%s };\n\n", spec.outputs.empty() ? " 0" : "");
+
+    // A network with no edges still gets a one-entry edge table, which no
+    // neuron's range reaches.
+
+    printf("            static constexpr edge_t edge_table[%lu] = {\n", max((size_t) 1, order.size()));
+    definitions << "    constexpr Network::edge_t Network::edge_table[" <<
+        max((size_t) 1, order.size()) << "];\n";
+
+    for (size_t j = 0; j < order.size(); j++) {
+        const risp::Edge_Spec & e = spec.edges[order[j]];
+        const string entry = "{ " + value(p, e.weight, "weight") + ", " + to_string(e.delay) +
+            ", " + to_string(table_index[spec.node_index(e.to)]) + " },";
+        printf("                %-32s// n%d -> n%d\n", entry.c_str(), e.from, e.to);
+    }
+
+    if (order.empty()) printf("                { 0, 0, 0 }\n");
+
+    printf("            };\n");
+
+    if (p.noisy() && !order.empty()) {
+
+        printf("\n            static constexpr uint32_t edge_id_table[%lu] = {", order.size());
+        definitions << "    constexpr uint32_t Network::edge_id_table[" << order.size() << "];\n";
+        for (size_t j = 0; j < order.size(); j++) printf("%s%lu", j == 0 ? " " : ", ", order[j]);
+        printf(" };\n\n");
+
+        printf("            static constexpr float edge_stddev_table[%lu] = {", order.size());
+        definitions << "    constexpr float Network::edge_stddev_table[" << order.size() << "];\n";
+        for (size_t j = 0; j < order.size(); j++) {
+            printf("%s%.9g", j == 0 ? " " : ", ", spec.edges[order[j]].stddev);
+        }
+        printf(" };\n");
+    }
+
+    printf("    };\n\n");
+    printf("%s", definitions.str().c_str());
+    printf("}\n");
+}
+
+int main(int argc, char **argv)
+{
+    if (argc != 2 && argc != 3) {
+        fprintf(stderr, "usage: network_to_header network_json [params_json]\n");
+        exit(1);
+    }
+
+    const string network_file = argv[1];
+    const string params_file = (argc == 3) ? argv[2] : "";
+
+    try {
+
+        risp::Network_Spec spec;
+
+        spec.load(network_file, params_file);
+
+        emit(spec, network_file, params_file);
+
+    } catch (const runtime_error &e) {
+        fprintf(stderr, "network_to_header: %s\n", e.what());
+        exit(1);
+    }
+
+    return 0;
+}
@@ -0,0 +1,478 @@
+#include <algorithm>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <vector>
+
+// The network_tool: reads commands on standard input to create and modify a
+// network, and writes it as JSON (markdown/network_json_format.md).  This
+// implements the commands that network construction needs -- enough for
+// markdown/network_tool.md's "AN / AE / SNP / TJ" workflow and for
+// scripts/test_vrisp.sh -- not the viz, pruning and randomization ones.
+
+#include "utils/json.hpp"
+
+using namespace std;
+
+typedef runtime_error SRE;
+
+typedef struct {
+
+    string name;
+    vector <double> values;
+
+} node_t;
+
+class Network {
+
+    public:
+
+        void from_json(const neuro::Json & j)
+        {
+            nodes.clear();
+            edges.clear();
+            inputs.clear();
+            outputs.clear();
+
+            properties = j["Properties"];
+            network_values = j.contains("Network_Values") ?
+                j["Network_Values"] : neuro::Json::make(neuro::Json::Array);
+            associated_data = j.contains("Associated_Data") ?
+                j["Associated_Data"] : neuro::Json::make(neuro::Json::Object);
+
+            const neuro::Json & jn = j["Nodes"];
+
+            for (size_t i = 0; i < jn.size(); i++) {
+                node_t & n = add_node(jn[i]["id"].as_int());
+                if (jn[i].contains("name")) n.name = jn[i]["name"].as_string();
+                n.values = values(jn[i]["values"]);
+            }
+
+            const neuro::Json & je = j["Edges"];
+
+            for (size_t i = 0; i < je.size(); i++) {
+                add_edge(je[i]["from"].as_int(), je[i]["to"].as_int()) = values(je[i]["values"]);
+            }
+
+            for (size_t i = 0; i < j["Inputs"].size(); i++) {
+                add_input(j["Inputs"][i].as_int());
+            }
+
+            for (size_t i = 0; i < j["Outputs"].size(); i++) {
+                add_output(j["Outputs"][i].as_int());
+            }
+        }
+
+        neuro::Json as_json() const
+        {
+            neuro::Json j = neuro::Json::make(neuro::Json::Object);
+            neuro::Json jn = neuro::Json::make(neuro::Json::Array);
+            neuro::Json je = neuro::Json::make(neuro::Json::Array);
+
+            for (map <int, node_t>::const_iterator it = nodes.begin(); it != nodes.end(); it++) {
+
+                neuro::Json n = neuro::Json::make(neuro::Json::Object);
+
+                n["id"] = neuro::Json::make_number(it->first);
+                if (it->second.name != "") n["name"] = neuro::Json::make_string(it->second.name);
+                n["values"] = values(it->second.values);
+
+                jn.push_back(n);
+            }
+
+            for (map <pair <int, int>, vector <double> >::const_iterator it = edges.begin();
+                    it != edges.end(); it++) {
+
+                neuro::Json e = neuro::Json::make(neuro::Json::Object);
+
+                e["from"] = neuro::Json::make_number(it->first.first);
+                e["to"] = neuro::Json::make_number(it->first.second);
+                e["values"] = values(it->second);
+
+                je.push_back(e);
+            }
+
+            j["Properties"] = properties;
+            j["Nodes"] = jn;
+            j["Edges"] = je;
+            j["Inputs"] = ids(inputs);
+            j["Outputs"] = ids(outputs);
+            j["Network_Values"] = network_values;
+            j["Associated_Data"] = associated_data;
+
+            return j;
+        }
+
+        node_t & add_node(const int id)
+        {
+            if (nodes.find(id) != nodes.end()) throw SRE("Node " + to_string(id) + " already exists");
+
+            node_t & n = nodes[id];
+
+            n.values = defaults("node_properties");
+
+            return n;
+        }
+
+        vector <double> & add_edge(const int from, const int to)
+        {
+            node(from);
+            node(to);
+
+            const pair <int, int> key(from, to);
+
+            if (edges.find(key) != edges.end()) {
+                throw SRE("Edge " + to_string(from) + " -> " + to_string(to) + " already exists");
+            }
+
+            vector <double> & e = edges[key];
+
+            e = defaults("edge_properties");
+
+            return e;
+        }
+
+        void add_input(const int id)
+        {
+            node(id);
+            if (find(inputs.begin(), inputs.end(), id) != inputs.end()) {
+                throw SRE("Node " + to_string(id) + " is already an input");
+            }
+            inputs.push_back(id);
+        }
+
+        void add_output(const int id)
+        {
+            node(id);
+            if (find(outputs.begin(), outputs.end(), id) != outputs.end()) {
+                throw SRE("Node " + to_string(id) + " is already an output");
+            }
+            outputs.push_back(id);
+        }
+
+        node_t & node(const int id)
+        {
+            map <int, node_t>::iterator it = nodes.find(id);
+
+            if (it == nodes.end()) throw SRE("Node " + to_string(id) + " does not exist");
+
+            return it->second;
+        }
+
+        vector <double> & edge(const int from, const int to)
+        {
+            map <pair <int, int>, vector <double> >::iterator it = edges.find(make_pair(from, to));
+
+            if (it == edges.end()) {
+                throw SRE("Edge " + to_string(from) + " -> " + to_string(to) + " does not exist");
+            }
+
+            return it->second;
+        }
+
+        // Looks up a node or edge property and checks value against its range.
+
+        int property(const char * kind, const string & name, const double value) const
+        {
+            const neuro::Json & props = properties[kind];
+
+            for (size_t i = 0; i < props.size(); i++) {
+
+                if (props[i]["name"].as_string() == name) {
+
+                    if (value < props[i]["min_value"].as_double() ||
+                            value > props[i]["max_value"].as_double()) {
+                        ostringstream ss;
+                        ss << "Value " << value << " is out of range for property " << name;
+                        throw SRE(ss.str());
+                    }
+
+                    return props[i]["index"].as_int();
+                }
+            }
+
+            throw SRE("No property named " + name);
+        }
+
+        map <int, node_t> nodes;
+        map <pair <int, int>, vector <double> > edges;
+
+    private:
+
+        neuro::Json properties;
+        neuro::Json network_values;
+        neuro::Json associated_data;
+        vector <int> inputs;
+        vector <int> outputs;
+
+        // New nodes and edges start with each property at its maximum value.
+
+        vector <double> defaults(const char * kind) const
+        {
+            const neuro::Json & props = properties[kind];
+            vector <double> v;
+
+            for (size_t i = 0; i < props.size(); i++) {
+
+                const size_t index = props[i]["index"].as_int();
+                const size_t size = props[i]["size"].as_int();
+
+                if (v.size() < index + size) v.resize(index + size, 0);
+
+                for (size_t k = index; k < index + size; k++) {
+                    v[k] = props[i]["max_value"].as_double();
+                }
+            }
+
+            return v;
+        }
+
+        static vector <double> values(const neuro::Json & j)
+        {
+            vector <double> v;
+
+            for (size_t i = 0; i < j.size(); i++) v.push_back(j[i].as_double());
+
+            return v;
+        }
+
+        static neuro::Json values(const vector <double> & v)
+        {
+            neuro::Json j = neuro::Json::make(neuro::Json::Array);
+
+            for (size_t i = 0; i < v.size(); i++) j.push_back(neuro::Json::make_number(v[i]));
+
+            return j;
+        }
+
+        static neuro::Json ids(const vector <int> & v)
+        {
+            neuro::Json j = neuro::Json::make(neuro::Json::Array);
+
+            for (size_t i = 0; i < v.size(); i++) j.push_back(neuro::Json::make_number(v[i]));
+
+            return j;
+        }
+};
+
+static void print_commands(FILE * f)
+{
+    fprintf(f, "This is a network tool program. The commands listed below are case-insensitive.\n");
+    fprintf(f, "\n");
+    fprintf(f, "FJ json                    - Read a network.\n");
+    fprintf(f, "TJ [file]                  - Create JSON from the network.\n");
+    fprintf(f, "AN node_id ...             - Add nodes\n");
+    fprintf(f, "AI node_id ...             - Add inputs\n");
+    fprintf(f, "AO node_id ...             - Add outputs\n");
+    fprintf(f, "AE from to ...             - Add edges\n");
+    fprintf(f, "SETNAME node_id name       - Set the names of nodes. A name of \"-\" clears the name\n");
+    fprintf(f, "SNP node_id ... name value - Set the node's named property to value.\n");
+    fprintf(f, "SEP from to ... name value - Set the edge's named property to value.\n");
+    fprintf(f, "SNP_ALL name value         - Set named property to value for all nodes.\n");
+    fprintf(f, "SEP_ALL name value         - Set named property to value for all edges.\n");
+    fprintf(f, "SORT/SORTED [Q]            - Sort the network and print the sorted node id's. Q = no output\n");
+    fprintf(f, "?                          - Print commands.\n");
+    fprintf(f, "Q                          - Quit.\n");
+}
+
+static int to_int(const string & s)
+{
+    int v;
+
+    if (sscanf(s.c_str(), "%d", &v) != 1) throw SRE("Bad node id " + s);
+
+    return v;
+}
+
+static double to_double(const string & s)
+{
+    double v;
+
+    if (sscanf(s.c_str(), "%lf", &v) != 1) throw SRE("Bad value " + s);
+
+    return v;
+}
+
+static void to_uppercase(string &s)
+{
+    size_t i;
+    for (i = 0; i < s.size(); i++) {
+        if (s[i] >= 'a' && s[i] <= 'z') {
+            s[i] = s[i] + 'A' -'a';
+        }
+    }
+}
+
+int main(int argc, char **argv)
+{
+    string prompt;
+
+    istringstream ss;
+
+    vector <string> sv;
+
+    if (argc == 2) {
+        prompt = argv[1];
+        prompt += " ";
+    }
+
+    Network * net = nullptr;
+
+    while (true) {
+
+        try {
+
+            if (prompt != "") printf("%s", prompt.c_str());
+
+            string l;
+
+            if (!getline(cin, l)) exit(0);
+
+            sv.clear();
+            ss.clear();
+            ss.str(l);
+
+            string s;
+
+            while (ss >> s) sv.push_back(s);
+
+            if (sv.size() == 0 || sv[0][0] == '#') continue;
+
+            to_uppercase(sv[0]);
+
+            if (sv[0] == "Q") {
+                exit(0);
+            }
+
+            else if (sv[0] == "?") {
+                print_commands(stdout);
+            }
+
+            else if (sv[0] == "FJ") {
+
+                if (sv.size() != 2) throw SRE("usage: FJ json_file");
+
+                delete net;
+                net = nullptr;
+                net = new Network();
+                net->from_json(neuro::Json::read_file(sv[1]));
+            }
+
+            else if (net == nullptr) {
+                throw SRE("No network -- read one with FJ first");
+            }
+
+            else if (sv[0] == "TJ") {
+
+                if (sv.size() > 2) throw SRE("usage: TJ [file]");
+
+                if (sv.size() == 2) {
+                    net->as_json().write_file(sv[1]);
+                }
+                else {
+                    printf("%s\n", net->as_json().dump().c_str());
+                }
+            }
+
+            else if (sv[0] == "AN" || sv[0] == "AI" || sv[0] == "AO") {
+
+                for (size_t i = 1; i < sv.size(); i++) {
+                    const int id = to_int(sv[i]);
+                    if (sv[0] == "AN") net->add_node(id);
+                    if (sv[0] == "AI") net->add_input(id);
+                    if (sv[0] == "AO") net->add_output(id);
+                }
+            }
+
+            else if (sv[0] == "AE") {
+
+                if (sv.size() % 2 != 1) throw SRE("usage: AE from to ...");
+
+                for (size_t i = 1; i < sv.size(); i += 2) {
+                    net->add_edge(to_int(sv[i]), to_int(sv[i+1]));
+                }
+            }
+
+            else if (sv[0] == "SETNAME") {
+
+                if (sv.size() != 3) throw SRE("usage: SETNAME node_id name");
+
+                net->node(to_int(sv[1])).name = (sv[2] == "-") ? "" : sv[2];
+            }
+
+            else if (sv[0] == "SNP" || sv[0] == "SNP_ALL") {
+
+                const bool all = (sv[0] == "SNP_ALL");
+
+                if (sv.size() < 3 || (all && sv.size() != 3) || (!all && sv.size() < 4)) {
+                    throw SRE("usage: SNP node_id ... name value / SNP_ALL name value");
+                }
+
+                const double value = to_double(sv[sv.size()-1]);
+                const int index = net->property("node_properties", sv[sv.size()-2], value);
+
+                if (all) {
+                    for (map <int, node_t>::iterator it = net->nodes.begin();
+                            it != net->nodes.end(); it++) {
+                        it->second.values[index] = value;
+                    }
+                }
+                else {
+                    for (size_t i = 1; i < sv.size()-2; i++) {
+                        net->node(to_int(sv[i])).values[index] = value;
+                    }
+                }
+            }
+
+            else if (sv[0] == "SEP" || sv[0] == "SEP_ALL") {
+
+                const bool all = (sv[0] == "SEP_ALL");
+
+                if (sv.size() < 3 || (all && sv.size() != 3) || (!all && sv.size() % 2 != 1)) {
+                    throw SRE("usage: SEP from to ... name value / SEP_ALL name value");
+                }
+
+                const double value = to_double(sv[sv.size()-1]);
+                const int index = net->property("edge_properties", sv[sv.size()-2], value);
+
+                if (all) {
+                    for (map <pair <int, int>, vector <double> >::iterator it = net->edges.begin();
+                            it != net->edges.end(); it++) {
+                        it->second[index] = value;
+                    }
+                }
+                else {
+                    for (size_t i = 1; i < sv.size()-2; i += 2) {
+                        net->edge(to_int(sv[i]), to_int(sv[i+1]))[index] = value;
+                    }
+                }
+            }
+
+            else if (sv[0] == "SORT" || sv[0] == "SORTED") {
+
+                if (sv.size() > 2 || (sv.size() == 2 && sv[1] != "Q")) {
+                    throw SRE("usage: SORT/SORTED [Q] - Sort the network and print the sorted node id's."
+                            " Q = no output");
+                }
+
+                // Nodes are always kept sorted by id.
+
+                if (sv.size() == 1) {
+                    for (map <int, node_t>::iterator it = net->nodes.begin();
+                            it != net->nodes.end(); it++) {
+                        printf("%s%d", (it == net->nodes.begin()) ? "" : " ", it->first);
+                    }
+                    printf("\n");
+                }
+            }
+
+            else {
+                throw SRE("Invalid command " + sv[0] + ".  Use '?' to print a list of commands");
+            }
+
+        } catch (const SRE &e) {
+            printf("%s\n", e.what());
+        }
+
+    }  // end of while loop
+}
@@ -1,13 +1,120 @@
+#include <fstream>
 #include <iostream>
 #include <sstream>
 #include <vector>
 
-#include "risp.hpp"
+// Built against the generated, network-specialized risp::Network by default.
+// With -DRISP_RUNTIME, it uses risp::Runtime_Network, which loads the network
+// named in the ML command instead, and can evaluate many networks on many
+// episodes over a thread pool (EVAL).  With -DVRISP, it is the VRISP processor
+// tool, which also makes processors (M) and empty networks (EMPTYNET) for
+// network_tool, and reports in the framework's processor_tool format.
+
+#if defined(VRISP)
+#include "vrisp.hpp"
+typedef vrisp::Network Network;
+#elif defined(RISP_RUNTIME)
+#include "risp_population.hpp"
+#include "risp_runtime.hpp"
+typedef risp::Runtime_Network Network;
+#else
+#include "risp_network.hpp"
+#include "risp_spec.hpp"
+typedef risp::Network Network;
+#endif
 
 using namespace std;
 
 typedef runtime_error SRE;
 
+static Network * make_network(const vector <string> &sv)
+{
+#if defined(VRISP) || defined(RISP_RUNTIME)
+    if (sv.size() != 2) throw SRE("usage: ML network_json");
+    return new Network(sv[1]);
+#else
+    (void)sv;
+    return new Network();
+#endif
+}
+
+static void check_loaded(const Network * net)
+{
+    if (net == nullptr) throw SRE("Processor or network is not loaded");
+}
+
+#ifndef VRISP
+
+// The indices of the outputs whose node ids are sv[1] ..., or of every output.
+
+static vector <size_t> output_indices(const Network * net, const vector <string> &sv)
+{
+    vector <size_t> outputs;
+
+    for (size_t i = 1; i < sv.size(); i++) {
+
+        const int id = atoi(sv[i].c_str());
+        size_t o = 0;
+
+        while (o < net->num_outputs() && net->output_id(o) != id) o++;
+
+        if (o == net->num_outputs()) throw SRE(sv[i] + " is not an output neuron");
+
+        outputs.push_back(o);
+    }
+
+    if (sv.size() == 1) {
+        for (size_t o = 0; o < net->num_outputs(); o++) outputs.push_back(o);
+    }
+
+    return outputs;
+}
+#endif
+
+#ifdef RISP_RUNTIME
+
+// An episodes file is processor_tool input: AS/ASV lines add spikes to the
+// current episode, with values as the AS and ASV commands take them, and a
+// RUN line ends it.  Other lines are ignored.
+
+static vector <risp::Episode> read_episodes(const string & filename)
+{
+    ifstream f(filename.c_str());
+    vector <risp::Episode> episodes;
+    risp::Episode ep;
+    string l;
+
+    if (!f) throw SRE("Couldn't open " + filename);
+
+    while (getline(f, l)) {
+
+        istringstream ls(l);
+        string op;
+        risp::spike_t spike;
+        double t, v;
+
+        if (!(ls >> op)) continue;
+
+        if (op == "AS" || op == "as" || op == "ASV" || op == "asv") {
+            while (ls >> spike.id >> t >> v) {
+                spike.time = t;
+                spike.value = v;
+                spike.normalized = (op == "AS" || op == "as");
+                ep.spikes.push_back(spike);
+            }
+        }
+        else if (op == "RUN" || op == "run") {
+            if (!(ls >> ep.run_time) || ep.run_time < 0) throw SRE("Bad RUN line in " + filename);
+            episodes.push_back(ep);
+            ep = risp::Episode();
+        }
+    }
+
+    return episodes;
+}
+
+#endif
+
 static void to_uppercase(string &s) 
 {
     size_t i;
@@ -31,7 +138,11 @@ int main(int argc, char **argv)
         prompt += " ";
     }
 
-    risp::Network * net = nullptr;
+    Network * net = nullptr;
+
+#ifdef VRISP
+    neuro::Json proc_params;
+#endif
 
     while (true) {
 
@@ -51,15 +162,118 @@ int main(int argc, char **argv)
 
             while (ss >> s) sv.push_back(s);
 
-            if (sv.size() != 0) to_uppercase(sv[0]); 
+            // Blank lines and comments are skipped.  A blank line once fell
+            // through to the commands with sv empty and re-ran the previous
+            // command, which printed full_input.txt's OC counts twice.
+
+            if (sv.size() == 0 || sv[0][0] == '#') continue;
 
-            if (sv[0] == "ML") {
+            to_uppercase(sv[0]);
 
-                net = new risp::Network();
+            if (sv[0] == "Q") {
+                exit(0);
             }
 
+            else if (sv[0] == "ML") {
+
+                delete net;
+                net = nullptr;
+                net = make_network(sv);
+
+#ifndef VRISP
+                // Outputs are tracked by default, so that OT works.
+
+                for (size_t o = 0; o < net->num_outputs(); o++) net->track_output_events(o);
+#endif
+            }
+
+#ifdef RISP_RUNTIME
+            // Prints one line per network and episode, in order: the network's
+            // position on the command line, the episode number, and its output
+            // counts.
+
+            else if (sv[0] == "EVAL") {
+
+                if (sv.size() < 4) throw SRE("usage: EVAL threads episodes_file network_json ...");
+
+                vector <risp::Network_Spec> networks(sv.size() - 3);
+
+                for (size_t i = 3; i < sv.size(); i++) networks[i-3].load(sv[i]);
+
+                const vector <risp::Episode> episodes = read_episodes(sv[2]);
+
+                risp::Population_Evaluator pool(atoi(sv[1].c_str()));
+
+                const vector < vector <uint32_t> > counts = pool.evaluate(networks, episodes);
+
+                for (size_t i = 0; i < counts.size(); i++) {
+                    printf("%lu %lu:", i / episodes.size(), i % episodes.size());
+                    for (size_t o = 0; o < counts[i].size(); o++) printf(" %u", counts[i][o]);
+                    printf("\n");
+                }
+            }
+#endif
+
+            else if (sv[0] == "CLEAR" || sv[0] == "C") {
+
+                check_loaded(net);
+                delete net;
+                net = nullptr;
+            }
+
+#ifdef VRISP
+            else if (sv[0] == "MAKE" || sv[0] == "M") {
+
+                if (sv.size() != 3) throw SRE("usage: MAKE proc_name processor_params_json");
+                if (sv[1] != "vrisp") throw SRE("This processor_tool only makes vrisp processors");
+
+                neuro::Json j = neuro::Json::read_file(sv[2]);
+                risp::Params p;
+
+                p.from_json(j);
+                vrisp::Network::check_params(p);
+
+                proc_params = j;
+            }
+
+            else if (sv[0] == "EMPTYNET") {
+
+                if (proc_params.type != neuro::Json::Object) throw SRE("Must make a processor first");
+
+                const neuro::Json empty = vrisp::Network::empty_network(proc_params);
+
+                if (sv.size() > 1) {
+                    empty.write_file(sv[1]);
+                }
+                else {
+                    printf("%s\n", empty.dump().c_str());
+                }
+            }
+
+            else if (sv[0] == "OLF") {
+
+                check_loaded(net);
+                net->report_last_fires();
+            }
+
+            else if (sv[0] == "NCH") {
+
+                vector <int> ids;
+
+                check_loaded(net);
+
+                for (size_t i = 1; i < sv.size(); i++) {
+                    ids.push_back(atoi(sv[i].c_str()));
+                }
+
+                net->report_charges(ids);
+            }
+#endif
+
             else if (sv[0] == "AS" || sv[0] == "ASV") {
 
+                check_loaded(net);
+
                 for (size_t i = 0; i < (sv.size() - 1) / 3; i++) {
 
                     int spike_id = 0;
@@ -74,30 +288,35 @@ int main(int argc, char **argv)
                                 sv[i*3 + 3] + "]\n");
                     } 
 
-                    switch (spike_id) {
+                    net->apply_spike(spike_id, spike_time, spike_val, sv[0] == "AS");
+                }
+            } 
+
+            else if (sv[0] == "ASR") {
 
-                        case 0:
-                            net->apply_spike_input0(spike_time);
-                            break;
+                check_loaded(net);
 
-                        case 1:
-                            net->apply_spike_input1(spike_time);
-                            break;
+                if (sv.size() != 3) throw SRE("usage: ASR node_id spike_raster_string");
 
-                        case 2:
-                            net->apply_spike_input2(spike_time);
-                            break;
+                const int spike_id = atoi(sv[1].c_str());
 
-                        default:
-                            break;
+                for (size_t i = 0; i < sv[2].size(); i++) {
+                    if (sv[2][i] != '0' && sv[2][i] != '1') {
+                        throw SRE("ASR -- Spike raster string must be only 0's and 1's.");
                     }
                 }
-            } 
+
+                for (size_t i = 0; i < sv[2].size(); i++) {
+                    if (sv[2][i] == '1') net->apply_spike(spike_id, i, 1, true);
+                }
+            }
 
             else if (sv[0] == "RUN") {
 
                 double sim_time = 0;
 
+                check_loaded(net);
+
                 if (sv.size() != 2 || sscanf(sv[1].c_str(), "%lf", &sim_time) != 1 || sim_time < 0) {
                     printf("usage: RUN sim_time. sim_time >= 0\n");
                 } else {
@@ -109,15 +328,167 @@ int main(int argc, char **argv)
 
             else if (sv[0] == "OC") {   
 
+                check_loaded(net);
                 net->report_counts();
             }
 
+            else if (sv[0] == "GT") {
+
+                check_loaded(net);
+                printf("time: %.1f\n", (double) net->get_time());
+            }
+
             else if (sv[0] == "CA" || sv[0] == "CLEAR-A") { // clear_activity
 
+                check_loaded(net);
                 net->clear_activity();
 
             }
 
+#ifndef VRISP
+            // Checks the loaded network's synapse tables against a network
+            // file's edges (see risp_topology.hpp).
+
+            else if (sv[0] == "TC") {
+
+                risp::Network_Spec spec;
+
+                check_loaded(net);
+
+                if (sv.size() != 2) throw SRE("usage: TC network_json");
+
+                spec.load(sv[1]);
+
+                const risp::Topology_Checksum c = net->topology_checksum();
+
+                const bool match = (c == spec.topology_checksum());
+
+                printf("edges %lu checksum %016lx: %s %s\n", (unsigned long) c.edges,
+                        (unsigned long) c.sum, match ? "matches" : "differs from", sv[1].c_str());
+            }
+
+            else if (sv[0] == "OLF") {
+
+                check_loaded(net);
+
+                const vector <size_t> outputs = output_indices(net, sv);
+
+                for (size_t i = 0; i < outputs.size(); i++) {
+                    printf("node %d last fire time: %.1f\n", net->output_id(outputs[i]),
+                            (double) net->output_last_fire(outputs[i]));
+                }
+            }
+
+            else if (sv[0] == "OT" || sv[0] == "OV") {
+
+                check_loaded(net);
+
+                const vector <size_t> outputs = output_indices(net, sv);
+
+                for (size_t i = 0; i < outputs.size(); i++) {
+
+                    const vector <int> times = net->output_vector(outputs[i]);
+
+                    printf("node %d spike times:", net->output_id(outputs[i]));
+                    for (size_t j = 0; j < times.size(); j++) printf(" %.1f", (double) times[j]);
+                    printf("\n");
+                }
+            }
+
+            else if (sv[0] == "TRACK_O" || sv[0] == "UNTRACK_O") {
+
+                check_loaded(net);
+
+                const vector <size_t> outputs = output_indices(net, sv);
+
+                for (size_t i = 0; i < outputs.size(); i++) {
+                    net->track_output_events(outputs[i], sv[0] == "TRACK_O");
+                }
+            }
+
+            else if (sv[0] == "TRACK_N" || sv[0] == "UNTRACK_N") {
+
+                vector <int> ids;
+
+                check_loaded(net);
+
+                for (size_t i = 1; i < sv.size(); i++) ids.push_back(atoi(sv[i].c_str()));
+
+                if (ids.empty()) ids = net->node_ids();
+
+                for (size_t i = 0; i < ids.size(); i++) {
+                    net->track_neuron_events(ids[i], sv[0] == "TRACK_N");
+                }
+            }
+
+            // Fire times of tracked neurons in the last run, and of untracked
+            // ones (which are empty) with show_nonfiring T.
+
+            else if (sv[0] == "NT" || sv[0] == "NV") {
+
+                check_loaded(net);
+
+                if (sv.size() == 2) to_uppercase(sv[1]);
+
+                if (sv.size() > 2 || (sv.size() == 2 && sv[1] != "T" && sv[1] != "F")) {
+                    throw SRE("usage: NT show_nonfiring(T/F)");
+                }
+
+                const bool show_nonfiring = (sv.size() == 2 && sv[1] == "T");
+                const vector <int> ids = net->node_ids();
+                const vector < vector <int> > times = net->neuron_vectors();
+                int width = 0;
+
+                for (size_t i = 0; i < ids.size(); i++) {
+                    width = max(width, (int) to_string(ids[i]).size());
+                }
+
+                for (size_t i = 0; i < ids.size(); i++) {
+
+                    if (times[i].empty() && !show_nonfiring) continue;
+
+                    printf("Node %*d fire times:", width, ids[i]);
+                    for (size_t j = 0; j < times[i].size(); j++) printf(" %.1f", (double) times[i][j]);
+                    printf("\n");
+                }
+
+                if (net->spikes_dropped() != 0) {
+                    printf("(%lu fires not recorded: the spike log is full)\n",
+                            (unsigned long) net->spikes_dropped());
+                }
+            }
+
+            // Saves the network's state to a snapshot file, or restores it
+            // from one (see risp_snapshot.hpp).
+
+            else if (sv[0] == "SAVE") {
+
+                check_loaded(net);
+
+                if (sv.size() != 2) throw SRE("usage: SAVE snapshot_file");
+
+                const vector <uint8_t> s = net->snapshot();
+                ofstream f(sv[1].c_str(), ios::binary);
+
+                if (!f.write((const char *) s.data(), s.size())) throw SRE("Couldn't write " + sv[1]);
+            }
+
+            else if (sv[0] == "RESTORE") {
+
+                check_loaded(net);
+
+                if (sv.size() != 2) throw SRE("usage: RESTORE snapshot_file");
+
+                ifstream f(sv[1].c_str(), ios::binary);
+
+                if (!f) throw SRE("Couldn't open " + sv[1]);
+
+                const vector <uint8_t> s((istreambuf_iterator<char>(f)), istreambuf_iterator<char>());
+
+                net->restore(s);
+            }
+#endif
+
         } catch (const SRE &e) {
             printf("%s\n", e.what());
         }
@@ -0,0 +1,287 @@
+// Replays a processor_tool input file (CA / AS / RUN / OC commands) on each
+// RISP engine and reports simulation throughput: overall, and for the time
+// spent inside run() alone, which is the step kernel.  The output counts of
+// every engine are checked against the specialized risp::Network.  The
+// batched engine replays the file on every lane at once, and its times are
+// per lane.  VRISP follows its own semantics (e.g. charge carries over
+// between timesteps differently), so its counts may legitimately differ.
+//
+// scripts/bench_compare.sh runs this benchmark as built at an earlier git
+// revision alongside this one, to reproduce a change's before and after.
+//
+// usage: risp_benchmark network_json input_file [passes]
+
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "risp_batch.hpp"
+#include "risp_network.hpp"
+#include "risp_parallel.hpp"
+#include "risp_runtime.hpp"
+#include "vrisp.hpp"
+
+using namespace std;
+
+typedef runtime_error SRE;
+
+typedef struct {
+
+    char op;       // 'C'lear, 'A'pply spike, 'R'un, 'O'utput counts
+    int id;
+    int time;
+
+} command_t;
+
+typedef struct {
+
+    string name;
+    double seconds;
+    double run_seconds;
+    vector <uint32_t> counts;
+
+} result_t;
+
+static vector <command_t> read_commands(const string & filename, size_t & timesteps)
+{
+    ifstream f(filename.c_str());
+    vector <command_t> cmds;
+    string l;
+
+    if (!f) throw SRE("Couldn't open " + filename);
+
+    timesteps = 0;
+
+    while (getline(f, l)) {
+
+        istringstream ss(l);
+        string op;
+        command_t c;
+
+        if (!(ss >> op)) continue;
+
+        c.id = 0;
+        c.time = 0;
+
+        if (op == "CA" || op == "CLEAR-A") {
+            c.op = 'C';
+            cmds.push_back(c);
+        }
+        else if (op == "AS") {
+            double t, v;
+            c.op = 'A';
+            while (ss >> c.id >> t >> v) {
+                c.time = (int) t;
+                cmds.push_back(c);
+            }
+        }
+        else if (op == "RUN") {
+            c.op = 'R';
+            ss >> c.time;
+            timesteps += c.time;
+            cmds.push_back(c);
+        }
+        else if (op == "OC") {
+            c.op = 'O';
+            cmds.push_back(c);
+        }
+    }
+
+    return cmds;
+}
+
+typedef chrono::steady_clock Clock;
+
+template <class Net>
+static void replay(Net & net, const vector <command_t> & cmds, vector <uint32_t> & counts,
+        double & run_seconds)
+{
+    Clock::time_point start;
+
+    for (size_t i = 0; i < cmds.size(); i++) {
+
+        const command_t & c = cmds[i];
+
+        switch (c.op) {
+
+            case 'C':
+                net.clear_activity();
+                break;
+
+            case 'A':
+                net.apply_spike(c.id, c.time);
+                break;
+
+            case 'R':
+                start = Clock::now();
+                net.run(c.time);
+                run_seconds += chrono::duration<double>(Clock::now() - start).count();
+                break;
+
+            case 'O':
+                for (size_t o = 0; o < net.num_outputs(); o++) {
+                    counts.push_back(net.output_count(o));
+                }
+                break;
+        }
+    }
+}
+
+// Batch_Network has an extra lane argument.  Every lane gets the same spikes;
+// lane 0's counts are reported, and a lane that disagrees with it empties
+// counts so that the check fails.
+
+template <uint32_t LANES>
+static void replay(risp::Batch_Network<LANES> & net, const vector <command_t> & cmds,
+        vector <uint32_t> & counts, double & run_seconds)
+{
+    Clock::time_point start;
+    bool lanes_agree = true;
+
+    for (size_t i = 0; i < cmds.size(); i++) {
+
+        const command_t & c = cmds[i];
+        uint32_t lane_counts[LANES];
+
+        switch (c.op) {
+
+            case 'C':
+                net.clear_activity();
+                break;
+
+            case 'A':
+                for (uint32_t l = 0; l < LANES; l++) net.apply_spike(l, c.id, c.time);
+                break;
+
+            case 'R':
+                start = Clock::now();
+                net.run(c.time);
+                run_seconds += chrono::duration<double>(Clock::now() - start).count();
+                break;
+
+            case 'O':
+                for (size_t o = 0; o < net.num_outputs(); o++) {
+                    net.output_counts(o, lane_counts);
+                    for (uint32_t l = 1; l < LANES; l++) {
+                        if (lane_counts[l] != lane_counts[0]) lanes_agree = false;
+                    }
+                    counts.push_back(lane_counts[0]);
+                }
+                break;
+        }
+    }
+
+    if (!lanes_agree) counts.clear();
+}
+
+template <class Net>
+static result_t time_engine(const string & name, Net & net,
+        const vector <command_t> & cmds, const int passes)
+{
+    result_t r;
+
+    r.name = name;
+    r.run_seconds = 0;
+
+    replay(net, cmds, r.counts, r.run_seconds);   // warm-up, and the counts we check
+
+    r.run_seconds = 0;
+
+    const Clock::time_point start = Clock::now();
+
+    for (int p = 0; p < passes; p++) {
+        vector <uint32_t> scratch;
+        replay(net, cmds, scratch, r.run_seconds);
+    }
+
+    r.seconds = chrono::duration<double>(Clock::now() - start).count();
+
+    return r;
+}
+
+int main(int argc, char **argv)
+{
+    if (argc != 3 && argc != 4) {
+        fprintf(stderr, "usage: risp_benchmark network_json input_file [passes]\n");
+        exit(1);
+    }
+
+    try {
+
+        size_t timesteps;
+
+        const vector <command_t> cmds = read_commands(argv[2], timesteps);
+        const int passes = (argc == 4) ? atoi(argv[3]) : 50;
+
+        vector <result_t> results;
+
+        risp::Network * specialized = new risp::Network();
+        results.push_back(time_engine("risp::Network", *specialized, cmds, passes));
+        const size_t peak_events = specialized->peak_bucket_events();
+        const size_t bucket_capacity = specialized->bucket_capacity();
+        delete specialized;
+
+        risp::Runtime_Network runtime(argv[1]);
+        results.push_back(time_engine("risp::Runtime_Network", runtime, cmds, passes));
+
+        risp::Parallel_Network * parallel = new risp::Parallel_Network(runtime.get_topology());
+        results.push_back(time_engine("risp::Parallel_Network<" +
+                    to_string(parallel->num_threads()) + ">", *parallel, cmds, passes));
+        delete parallel;
+
+        // VRISP only accepts spikes within tracked_timesteps of now, so track
+        // far enough ahead for the latest spike in the input file.
+
+        risp::Network_Spec spec;
+        int max_spike_time = 0;
+
+        spec.load(argv[1]);
+
+        for (size_t i = 0; i < cmds.size(); i++) {
+            if (cmds[i].op == 'A' && cmds[i].time > max_spike_time) max_spike_time = cmds[i].time;
+        }
+
+        if (spec.params.tracked_timesteps == 0) spec.params.tracked_timesteps = spec.params.max_delay + 1;
+        if (spec.params.tracked_timesteps <= max_spike_time) {
+            spec.params.tracked_timesteps = max_spike_time + 1;
+        }
+
+        risp::Batch_Network<16> * batch = new risp::Batch_Network<16>(argv[1]);
+        results.push_back(time_engine("risp::Batch_Network<16>", *batch, cmds, passes));
+        results.back().seconds /= batch->lanes();
+        results.back().run_seconds /= batch->lanes();
+        delete batch;
+
+        vrisp::Network vectorized(spec);
+        results.push_back(time_engine("vrisp::Network", vectorized, cmds, passes));
+
+        printf("%s: %lu timesteps per pass, %d passes\n\n", argv[2], timesteps, passes);
+        printf("%-28s %10s %14s %14s %10s %s\n", "engine", "seconds", "ns/timestep",
+                "run() ns/step", "relative", "");
+
+        const double steps = (double) timesteps * passes;
+
+        for (size_t i = 0; i < results.size(); i++) {
+
+            const result_t & r = results[i];
+
+            printf("%-28s %10.3f %14.2f %14.2f %9.2fx %s\n", r.name.c_str(), r.seconds,
+                    r.seconds * 1e9 / steps, r.run_seconds * 1e9 / steps,
+                    r.seconds / results[0].seconds,
+                    r.counts == results[0].counts ? "" : "OUTPUTS DIFFER");
+        }
+
+        printf("\nrisp::Network event buckets: peak %lu events, capacity %lu\n",
+                peak_events, bucket_capacity);
+
+    } catch (const SRE &e) {
+        fprintf(stderr, "risp_benchmark: %s\n", e.what());
+        exit(1);
+    }
+
+    return 0;
+}
@@ -0,0 +1,150 @@
+// Checks snapshots across neuron layouts.  It builds two Runtime_Topologys of
+// one network: one in the default layout, which the specialized risp::Network
+// shares, and one laid out by a made-up activity profile.  A snapshot taken
+// part way through a run must restore into any network with its layout and
+// continue exactly as the original does, and must be refused by a network
+// with the other layout.  A clone must also keep tracking the outputs and
+// neurons that the original tracks.
+//
+// usage: snapshot_test network_json
+
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "risp_network.hpp"
+#include "risp_runtime.hpp"
+
+using namespace std;
+
+typedef runtime_error SRE;
+
+static int failures = 0;
+
+static void check(const bool ok, const string & what)
+{
+    if (!ok) {
+        fprintf(stderr, "Failed -- %s\n", what.c_str());
+        failures++;
+    }
+}
+
+// Spikes on every input, a few timesteps apart.
+
+template <class Net>
+static void start(Net & net, const vector <int> & inputs)
+{
+    net.clear_activity();
+
+    for (size_t i = 0; i < inputs.size(); i++) {
+        for (int t = 0; t < 12; t += 2 + (int) i % 3) net.apply_spike(inputs[i], t);
+    }
+
+    net.run(3);
+}
+
+template <class Net>
+static vector <uint32_t> finish(Net & net)
+{
+    vector <uint32_t> counts;
+
+    net.run(20);
+    for (size_t o = 0; o < net.num_outputs(); o++) counts.push_back(net.output_count(o));
+
+    return counts;
+}
+
+template <class From, class To>
+static void check_restore(From & from, To & to, const bool same_layout, const vector <int> & inputs,
+        const string & what)
+{
+    start(from, inputs);
+
+    const vector <uint8_t> s = from.snapshot();
+    bool restored = true;
+
+    try {
+        to.restore(s);
+    } catch (const SRE &) {
+        restored = false;
+    }
+
+    if (!same_layout) {
+        check(!restored, what + ": restored a snapshot of another layout");
+        return;
+    }
+
+    check(restored, what + ": refused a snapshot of the same layout");
+    if (restored) check(finish(to) == finish(from), what + ": output counts differ after restore");
+}
+
+// Tracks every output and input, clones part way through a run, and checks
+// that the clone's fire times match the original's in the next run.
+
+template <class Net>
+static void check_clone(Net & net, const vector <int> & inputs, const string & what)
+{
+    for (size_t o = 0; o < net.num_outputs(); o++) net.track_output_events(o);
+    for (size_t i = 0; i < inputs.size(); i++) net.track_neuron_events(inputs[i]);
+
+    start(net, inputs);
+
+    unique_ptr <Net> c(net.clone());
+
+    check(finish(*c) == finish(net), what + ": clone's output counts differ");
+    check(c->output_vectors() == net.output_vectors(), what + ": clone's output fire times differ");
+    check(c->neuron_vectors() == net.neuron_vectors(), what + ": clone's neuron fire times differ");
+}
+
+int main(int argc, char **argv)
+{
+    if (argc != 2) {
+        fprintf(stderr, "usage: snapshot_test network_json\n");
+        exit(1);
+    }
+
+    try {
+
+        risp::Network_Spec spec;
+
+        spec.load(argv[1]);
+
+        // Activity decreasing with node index reverses the default
+        // layout's tie-breaking, so the two layouts differ.
+
+        vector <double> activity;
+
+        for (size_t i = 0; i < spec.nodes.size(); i++) activity.push_back(spec.nodes.size() - i);
+
+        const shared_ptr <const risp::Runtime_Topology> plain(new risp::Runtime_Topology(spec));
+        const shared_ptr <const risp::Runtime_Topology> profiled(
+                new risp::Runtime_Topology(spec, activity));
+
+        if (plain->neuron_layout() == profiled->neuron_layout()) throw SRE("the two layouts are the same");
+
+        risp::Network specialized;
+        risp::Runtime_Network a(plain), a2(plain), b(profiled), b2(profiled);
+
+        check_restore(a, a2, true, spec.inputs, "default into default");
+        check_restore(b, b2, true, spec.inputs, "profiled into profiled");
+        check_restore(specialized, a, true, spec.inputs, "risp::Network into default");
+        check_restore(a, b, false, spec.inputs, "default into profiled");
+        check_restore(b, a, false, spec.inputs, "profiled into default");
+        check_restore(specialized, b, false, spec.inputs, "risp::Network into profiled");
+
+        check_clone(specialized, spec.inputs, "risp::Network");
+        check_clone(a, spec.inputs, "Runtime_Network");
+
+    } catch (const SRE &e) {
+        fprintf(stderr, "snapshot_test: %s\n", e.what());
+        exit(1);
+    }
+
+    if (failures != 0) exit(1);
+
+    printf("Snapshots restore only into networks with the same layout, and clones track\n"
+            "the same outputs and neurons, on %s\n", argv[1]);
+
+    return 0;
+}
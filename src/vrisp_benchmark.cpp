@@ -0,0 +1,178 @@
+// Times the VRISP step kernels on a random dense network, built in memory:
+// every neuron is an input and an output, and has fanout synapses to random
+// targets with random delays.  Each kernel the CPU supports replays the same
+// spikes, and its fire counts are checked against the scalar kernel.
+//
+// usage: vrisp_benchmark [neurons] [fanout] [timesteps] [seed]
+
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "vrisp.hpp"
+
+using namespace std;
+
+typedef runtime_error SRE;
+
+static const int MAX_DELAY = 15;
+static const int EPISODE = 100;      // Timesteps per RUN; spikes are applied before each
+
+static risp::Network_Spec dense_network(const int neurons, const int fanout)
+{
+    risp::Network_Spec spec;
+
+    spec.params.min_weight = -8;
+    spec.params.max_weight = 8;
+    spec.params.min_threshold = 0;
+    spec.params.max_threshold = 15;
+    spec.params.min_potential = -8;
+    spec.params.max_delay = MAX_DELAY;
+    spec.params.discrete = true;
+    spec.params.leak_mode = "configurable";
+    spec.params.spike_value_factor = 8;
+
+    for (int i = 0; i < neurons; i++) {
+
+        risp::Node_Spec n;
+
+        n.id = i;
+        n.threshold = 1 + rand() % 15;
+        n.leak = (rand() % 2 == 0);
+
+        spec.nodes.push_back(n);
+        spec.inputs.push_back(i);
+        spec.outputs.push_back(i);
+
+        // Distinct targets, as a network file requires.
+
+        vector <bool> used(neurons, false);
+
+        for (int j = 0; j < fanout && j < neurons; j++) {
+
+            risp::Edge_Spec e;
+
+            do e.to = rand() % neurons; while (used[e.to]);
+            used[e.to] = true;
+
+            e.from = i;
+            e.weight = rand() % 9 - 5;
+            e.delay = 1 + rand() % MAX_DELAY;
+            e.stddev = 0;
+            e.weight_index = -1;
+
+            spec.edges.push_back(e);
+        }
+    }
+
+    return spec;
+}
+
+typedef chrono::steady_clock Clock;
+
+// Returns run() seconds, and every neuron's fire count after each episode.
+
+static double replay(vrisp::Network & net, const vector < vector <int> > & spikes,
+        const int episodes, vector <uint32_t> & counts)
+{
+    double seconds = 0;
+
+    net.clear_activity();
+
+    for (int e = 0; e < episodes; e++) {
+
+        const vector <int> & s = spikes[e];
+
+        for (size_t i = 0; i < s.size(); i++) {
+            net.apply_spike(s[i], i % MAX_DELAY);
+        }
+
+        const Clock::time_point start = Clock::now();
+        net.run(EPISODE);
+        seconds += chrono::duration<double>(Clock::now() - start).count();
+
+        for (size_t o = 0; o < net.num_outputs(); o++) {
+            counts.push_back(net.output_count(o));
+        }
+    }
+
+    return seconds;
+}
+
+int main(int argc, char **argv)
+{
+    if (argc > 5) {
+        fprintf(stderr, "usage: vrisp_benchmark [neurons] [fanout] [timesteps] [seed]\n");
+        exit(1);
+    }
+
+    try {
+
+        const int neurons = (argc > 1) ? atoi(argv[1]) : 4096;
+        const int fanout = (argc > 2) ? atoi(argv[2]) : 32;
+        const int timesteps = (argc > 3) ? atoi(argv[3]) : 20000;
+
+        srand((argc > 4) ? atoi(argv[4]) : 1);
+
+        if (neurons <= 0 || fanout < 0 || timesteps < EPISODE) {
+            throw SRE("neurons must be positive and timesteps at least 100");
+        }
+
+        const risp::Network_Spec spec = dense_network(neurons, fanout);
+        const int episodes = timesteps / EPISODE;
+
+        vector < vector <int> > spikes(episodes);
+
+        for (int e = 0; e < episodes; e++) {
+            for (int i = 0; i < neurons / 16; i++) spikes[e].push_back(rand() % neurons);
+        }
+
+        vrisp::Network net(spec);
+
+        printf("%d neurons, %d synapses, %d timesteps\n", neurons, (int) spec.edges.size(),
+                episodes * EPISODE);
+
+        const vrisp::Kernel kernels[] = { vrisp::SCALAR, vrisp::AVX2, vrisp::AVX512 };
+        vector <uint32_t> scalar_counts;
+        double scalar_seconds = 0;
+
+        for (size_t k = 0; k < sizeof(kernels) / sizeof(kernels[0]); k++) {
+
+            if (!vrisp::kernel_supported(kernels[k])) {
+                printf("%-8s %10s\n", vrisp::kernel_name(kernels[k]), "unsupported");
+                continue;
+            }
+
+            vector <uint32_t> counts;
+
+            net.set_kernel(kernels[k]);
+
+            const double seconds = replay(net, spikes, episodes, counts);
+
+            if (k == 0) {
+                scalar_counts = counts;
+                scalar_seconds = seconds;
+
+                double fires = 0;
+                for (size_t i = 0; i < counts.size(); i++) fires += counts[i];
+                printf("%.2f%% of neurons fire per timestep\n\n",
+                        100.0 * fires / neurons / (episodes * EPISODE));
+                printf("%-8s %10s %14s %10s %s\n", "kernel", "seconds", "ns/timestep",
+                        "speedup", "");
+            }
+
+            printf("%-8s %10.3f %14.2f %9.2fx %s\n", vrisp::kernel_name(kernels[k]), seconds,
+                    seconds * 1e9 / (episodes * EPISODE), scalar_seconds / seconds,
+                    counts == scalar_counts ? "" : "OUTPUTS DIFFER");
+        }
+
+    } catch (const SRE &e) {
+        fprintf(stderr, "vrisp_benchmark: %s\n", e.what());
+        exit(1);
+    }
+
+    return 0;
+}